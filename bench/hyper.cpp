@@ -0,0 +1,35 @@
+#include "lib/hyper.hpp"
+#include <benchmark/benchmark.h>
+#include <string>
+
+using namespace hyper;
+
+namespace {
+/// the shape of a docs table row, the part rendered most often
+void BM_hyper_part(benchmark::State &state) {
+  for (auto _ : state) {
+    std::string row =
+        part<tr<td<strong<$<"method">>>,
+                td<a<$href<"<<route>>">, code<$<"route">>>>,
+                td<$<"name">>, td<$<"description">>>>{
+            {{"method", "GET"},
+             {"route", "/api/artifact"},
+             {"name", "read"},
+             {"description", "Read artifact's metadata or download its file"}}};
+    benchmark::DoNotOptimize(row);
+  }
+}
+BENCHMARK(BM_hyper_part);
+
+void BM_hyper_html(benchmark::State &state) {
+  const std::string docs(state.range(0), 'x');
+  for (auto _ : state) {
+    std::string page =
+        html<head<meta<charset, "UTF-8">, title<text<"xbucket server">>>,
+             body<h1<text<"xbucket is running">>, hr<>, $<"docs">>>{
+            {{"docs", docs}}};
+    benchmark::DoNotOptimize(page);
+  }
+}
+BENCHMARK(BM_hyper_html)->Arg(0)->Arg(4 << 10)->Arg(64 << 10);
+} // namespace
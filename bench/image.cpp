@@ -0,0 +1,31 @@
+#include "util/image.hpp"
+#include <benchmark/benchmark.h>
+
+namespace {
+/// resizing a sliver source, whose scaled size must stay within
+/// constants::image::max_dimension however the transform asks for it
+void BM_image_resize_extreme(benchmark::State &state) {
+  const cv::Mat source(10000, 1, CV_8UC3, cv::Scalar(0, 128, 255));
+  const util::image::transform transforms[] = {
+      {.width = constants::image::max_dimension},
+      {.width = constants::image::max_dimension, .height = 1, .fit = "cover"},
+      {.width = 1, .height = constants::image::max_dimension, .fit = "cover"},
+      {.width = constants::image::max_dimension,
+       .height = constants::image::max_dimension},
+  };
+  for (auto _ : state) {
+    for (const auto &transform : transforms) {
+      auto result = util::image::resize(source, transform);
+      if (result.cols > constants::image::max_dimension ||
+          result.rows > constants::image::max_dimension ||
+          (transform.fit == "cover" && (result.cols != transform.width ||
+                                        result.rows != transform.height))) {
+        state.SkipWithError("resize exceeded the requested size");
+        return;
+      }
+      benchmark::DoNotOptimize(result.data);
+    }
+  }
+}
+BENCHMARK(BM_image_resize_extreme);
+} // namespace
@@ -0,0 +1,346 @@
+#include "load.hpp"
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <cctype>
+#include <cstdint>
+#include <cstdio>
+#include <cstring>
+#include <crow/json.h>
+#include <map>
+#include <netdb.h>
+#include <netinet/in.h>
+#include <netinet/tcp.h>
+#include <optional>
+#include <random>
+#include <stdexcept>
+#include <string>
+#include <sys/socket.h>
+#include <thread>
+#include <unistd.h>
+#include <vector>
+
+namespace bench {
+namespace load {
+namespace {
+struct options {
+  std::string host = "127.0.0.1";
+  int port = 8080;
+  int workers = 8;
+  int seconds = 10;
+  std::size_t size = 64 * 1024;
+
+  static options parse(int argc, char **argv) {
+    options result;
+    for (int i = 1; i + 1 < argc; i++) {
+      std::string name = argv[i];
+      std::string value = argv[i + 1];
+      if (name == "--host") {
+        result.host = value;
+      } else if (name == "--port") {
+        result.port = std::stoi(value);
+      } else if (name == "--workers") {
+        result.workers = std::max(1, std::stoi(value));
+      } else if (name == "--seconds") {
+        result.seconds = std::max(1, std::stoi(value));
+      } else if (name == "--size") {
+        result.size = std::stoul(value);
+      } else {
+        continue;
+      }
+      i++;
+    }
+    return result;
+  }
+};
+
+struct response {
+  int status = 0;
+  std::string body;
+};
+
+/// A keep-alive HTTP/1.1 connection, reopened once when the server drops it
+class connection {
+  const options &opts;
+  int fd = -1;
+  std::string buffer;
+
+  void open() {
+    addrinfo hints{}, *found = nullptr;
+    hints.ai_family = AF_UNSPEC;
+    hints.ai_socktype = SOCK_STREAM;
+    if (getaddrinfo(opts.host.c_str(), std::to_string(opts.port).c_str(),
+                    &hints, &found) != 0) {
+      throw std::runtime_error("cannot resolve " + opts.host);
+    }
+    for (auto *address = found; address; address = address->ai_next) {
+      fd = ::socket(address->ai_family, address->ai_socktype,
+                    address->ai_protocol);
+      if (fd >= 0 && ::connect(fd, address->ai_addr, address->ai_addrlen) == 0) {
+        break;
+      }
+      if (fd >= 0) {
+        ::close(fd);
+        fd = -1;
+      }
+    }
+    freeaddrinfo(found);
+    if (fd < 0) {
+      throw std::runtime_error("cannot connect to " + opts.host + ":" +
+                               std::to_string(opts.port));
+    }
+    int on = 1;
+    setsockopt(fd, IPPROTO_TCP, TCP_NODELAY, &on, sizeof(on));
+    buffer.clear();
+  }
+
+  void close() {
+    if (fd >= 0) {
+      ::close(fd);
+      fd = -1;
+    }
+  }
+
+  bool fill() {
+    char chunk[64 * 1024];
+    auto read = ::recv(fd, chunk, sizeof(chunk), 0);
+    if (read <= 0) {
+      return false;
+    }
+    buffer.append(chunk, read);
+    return true;
+  }
+
+  bool send_all(const std::string &data) {
+    std::size_t sent = 0;
+    while (sent < data.size()) {
+      auto written =
+          ::send(fd, data.data() + sent, data.size() - sent, MSG_NOSIGNAL);
+      if (written <= 0) {
+        return false;
+      }
+      sent += written;
+    }
+    return true;
+  }
+
+  std::optional<response> exchange(const std::string &request) {
+    if (!send_all(request)) {
+      return {};
+    }
+    std::size_t end;
+    while ((end = buffer.find("\r\n\r\n")) == std::string::npos) {
+      if (!fill()) {
+        return {};
+      }
+    }
+    auto head = buffer.substr(0, end);
+    std::transform(head.begin(), head.end(), head.begin(),
+                   [](unsigned char c) { return std::tolower(c); });
+    response result;
+    if (head.size() < 12) {
+      return {};
+    }
+    result.status = std::atoi(head.c_str() + 9);
+    std::size_t length = 0;
+    if (auto at = head.find("\r\ncontent-length:"); at != std::string::npos) {
+      length = std::stoul(head.substr(at + 17));
+    }
+    auto keep_alive = head.find("\r\nconnection: close") == std::string::npos;
+    buffer.erase(0, end + 4);
+    while (buffer.size() < length) {
+      if (!fill()) {
+        return {};
+      }
+    }
+    result.body = buffer.substr(0, length);
+    buffer.erase(0, length);
+    if (!keep_alive) {
+      close();
+    }
+    return result;
+  }
+
+public:
+  connection(const options &opts) : opts(opts) {}
+  ~connection() { close(); }
+
+  response request(const std::string &method, const std::string &target,
+                   const std::string &headers = "",
+                   const std::string &body = "") {
+    std::string request = method + " " + target +
+                           " HTTP/1.1\r\nHost: " + opts.host +
+                           "\r\nContent-Length: " +
+                           std::to_string(body.size()) + "\r\n" + headers +
+                           "\r\n" + body;
+    for (int attempt = 0; attempt < 2; attempt++) {
+      if (fd < 0) {
+        open();
+      }
+      if (auto result = exchange(request)) {
+        return *result;
+      }
+      close();
+    }
+    throw std::runtime_error(method + " " + target + ": connection lost");
+  }
+};
+
+/// latencies of one flow step, in microseconds
+struct step {
+  std::vector<std::uint64_t> latencies;
+  std::uint64_t errors = 0;
+
+  void merge(const step &other) {
+    latencies.insert(latencies.end(), other.latencies.begin(),
+                     other.latencies.end());
+    errors += other.errors;
+  }
+};
+
+using steps = std::map<std::string, step>;
+
+/// times `call` as `name`, non 2xx answers count as errors
+template <typename Call>
+response timed(steps &stats, const std::string &name, Call call) {
+  auto started = std::chrono::steady_clock::now();
+  auto result = call();
+  auto elapsed = std::chrono::duration_cast<std::chrono::microseconds>(
+                     std::chrono::steady_clock::now() - started)
+                     .count();
+  auto &current = stats[name];
+  if (result.status / 100 == 2) {
+    current.latencies.push_back(elapsed);
+  } else {
+    current.errors++;
+  }
+  return result;
+}
+
+steps worker(const options &opts, int index,
+             std::chrono::steady_clock::time_point deadline) {
+  steps stats;
+  connection conn(opts);
+  const std::string json = "Content-Type: application/json\r\n";
+  const auto email = "bench-" + std::to_string(::getpid()) + "-" +
+                     std::to_string(index) + "@xbucket";
+  crow::json::wvalue credentials{
+      {"name", "bench"}, {"email", email}, {"password", "bench"}};
+
+  timed(stats, "user:create", [&] {
+    return conn.request("POST", "/api/user", json, credentials.dump());
+  });
+  auto token = timed(stats, "auth:token", [&] {
+    return conn.request("POST", "/api/auth/token", json, credentials.dump());
+  });
+  if (token.status != 200) {
+    throw std::runtime_error("could not get a token: " + token.body);
+  }
+  const auto auth = json + "Authorization: Bearer " +
+                    std::string(crow::json::load(token.body)["token"].s()) +
+                    "\r\n";
+  auto bucket = timed(stats, "bucket:create", [&] {
+    return conn.request(
+        "POST", "/api/bucket", auth,
+        crow::json::wvalue{{"name", "bench"}, {"description", "load"}}.dump());
+  });
+  if (bucket.status != 200) {
+    throw std::runtime_error("could not create a bucket: " + bucket.body);
+  }
+  const auto bucket_id =
+      std::to_string(crow::json::load(bucket.body)["id"].i());
+
+  const std::string boundary = "xbucket-bench-boundary";
+  const auto multipart =
+      "Content-Type: multipart/form-data; boundary=" + boundary + "\r\n" +
+      "Authorization: Bearer " +
+      std::string(crow::json::load(token.body)["token"].s()) + "\r\n";
+  std::string content(opts.size, '\0');
+  std::mt19937_64 random(index);
+  for (auto &c : content) {
+    c = static_cast<char>(random());
+  }
+  for (std::uint64_t n = 0; std::chrono::steady_clock::now() < deadline; n++) {
+    // distinct content per upload, identical files would share a blob
+    std::memcpy(content.data(), &n, std::min(sizeof(n), content.size()));
+    auto body = "--" + boundary +
+                "\r\nContent-Disposition: form-data; name=\"file\"; "
+                "filename=\"bench.bin\"\r\n"
+                "Content-Type: application/octet-stream\r\n\r\n" +
+                content + "\r\n--" + boundary + "--\r\n";
+    auto created = timed(stats, "artifact:create", [&] {
+      return conn.request("POST", "/api/artifact?bucket_id=" + bucket_id,
+                          multipart, body);
+    });
+    if (created.status != 200) {
+      continue;
+    }
+    auto id = std::to_string(crow::json::load(created.body)[std::size_t{0}]["id"].i());
+    timed(stats, "artifact:read", [&] {
+      return conn.request("GET",
+                          "/api/artifact?dl=true&id=" + id +
+                              "&bucket_id=" + bucket_id,
+                          auth);
+    });
+  }
+  return stats;
+}
+
+double percentile(const std::vector<std::uint64_t> &sorted, double p) {
+  if (sorted.empty()) {
+    return 0;
+  }
+  auto rank = static_cast<std::size_t>(p * (sorted.size() - 1) + 0.5);
+  return sorted[rank] / 1000.0;
+}
+} // namespace
+
+int run(int argc, char **argv) {
+  auto opts = options::parse(argc, argv);
+  std::printf("load: %d workers for %ds against %s:%d, %zu byte files\n",
+              opts.workers, opts.seconds, opts.host.c_str(), opts.port,
+              opts.size);
+  auto started = std::chrono::steady_clock::now();
+  auto deadline = started + std::chrono::seconds(opts.seconds);
+  std::vector<steps> results(opts.workers);
+  std::vector<std::thread> threads;
+  std::atomic<int> failed{0};
+  for (int i = 0; i < opts.workers; i++) {
+    threads.emplace_back([&, i] {
+      try {
+        results[i] = worker(opts, i, deadline);
+      } catch (std::exception &e) {
+        std::fprintf(stderr, "worker %d: %s\n", i, e.what());
+        failed++;
+      }
+    });
+  }
+  for (auto &thread : threads) {
+    thread.join();
+  }
+  auto elapsed = std::chrono::duration<double>(
+                     std::chrono::steady_clock::now() - started)
+                     .count();
+  steps total;
+  for (auto &result : results) {
+    for (auto &[name, step] : result) {
+      total[name].merge(step);
+    }
+  }
+  std::printf("%-16s %9s %7s %10s %9s %9s %9s %9s\n", "step", "requests",
+              "errors", "req/s", "p50 ms", "p90 ms", "p99 ms", "max ms");
+  for (auto &[name, step] : total) {
+    std::sort(step.latencies.begin(), step.latencies.end());
+    std::printf("%-16s %9zu %7llu %10.1f %9.2f %9.2f %9.2f %9.2f\n",
+                name.c_str(), step.latencies.size(),
+                static_cast<unsigned long long>(step.errors),
+                step.latencies.size() / elapsed,
+                percentile(step.latencies, 0.5),
+                percentile(step.latencies, 0.9),
+                percentile(step.latencies, 0.99),
+                percentile(step.latencies, 1));
+  }
+  return failed ? 1 : 0;
+}
+} // namespace load
+} // namespace bench
@@ -0,0 +1,13 @@
+#pragma once
+
+namespace bench {
+namespace load {
+/// Replays the demo collection's flows against a running server and prints
+/// throughput and latency percentiles per step. Every worker creates its
+/// own user, gets a bearer token and a bucket, then loops uploading a file
+/// and downloading it back.
+///   --host <127.0.0.1> --port <8080> --workers <8> --seconds <10>
+///   --size <65536> bytes per uploaded file
+int run(int argc, char **argv);
+} // namespace load
+} // namespace bench
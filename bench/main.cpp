@@ -0,0 +1,20 @@
+#include "load.hpp"
+#include <benchmark/benchmark.h>
+#include <cstring>
+
+/// Runs the micro-benchmarks, or with `--load` the http load generator
+/// against a running server (see load.hpp for its options)
+int main(int argc, char **argv) {
+  for (int i = 1; i < argc; i++) {
+    if (std::strcmp(argv[i], "--load") == 0) {
+      return bench::load::run(argc, argv);
+    }
+  }
+  benchmark::Initialize(&argc, argv);
+  if (benchmark::ReportUnrecognizedArguments(argc, argv)) {
+    return 1;
+  }
+  benchmark::RunSpecifiedBenchmarks();
+  benchmark::Shutdown();
+  return 0;
+}
@@ -0,0 +1,38 @@
+#include "model/artifact.hpp"
+#include "model/bucket.hpp"
+#include "model/user.hpp"
+#include <benchmark/benchmark.h>
+#include <crow/json.h>
+#include <string>
+
+namespace {
+/// parse, build the model and serialize it back, what every api call does
+template <typename T> void BM_model_round_trip(benchmark::State &state) {
+  const std::string body = T::from_json_sample().dump();
+  for (auto _ : state) {
+    auto model = T::from_json(crow::json::load(body));
+    auto json = model.to_json().dump();
+    benchmark::DoNotOptimize(json);
+  }
+  state.SetBytesProcessed(state.iterations() * body.size());
+}
+BENCHMARK(BM_model_round_trip<model::user>);
+BENCHMARK(BM_model_round_trip<model::bucket>);
+
+void BM_model_artifact_to_json(benchmark::State &state) {
+  model::artifact artifact{.id = 1,
+                           .name = "file",
+                           .filename = std::string(64, 'a') + ".png",
+                           .original_filename = "photo.png",
+                           .bucket_id = 1,
+                           .sha256 = std::string(64, 'a'),
+                           .crc32c = "deadbeef",
+                           .created_at = "2024-01-01 00:00:00",
+                           .updated_at = "2024-01-01 00:00:00"};
+  for (auto _ : state) {
+    auto json = artifact.to_json().dump();
+    benchmark::DoNotOptimize(json);
+  }
+}
+BENCHMARK(BM_model_artifact_to_json);
+} // namespace
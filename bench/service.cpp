@@ -0,0 +1,87 @@
+#include "model/model.hpp"
+#include "service/artifact.hpp"
+#include "service/bucket.hpp"
+#include "service/user.hpp"
+#include <benchmark/benchmark.h>
+#include <filesystem>
+#include <string>
+
+namespace {
+constexpr int buckets = 16;
+constexpr int artifacts_per_bucket = 10000;
+
+/// A database seeded once per run in the temp directory: one user, 16
+/// buckets of 10k artifacts each
+model::storage_pool &seeded_pool() {
+  static auto path =
+      (std::filesystem::temp_directory_path() / "xbucket-bench.db").string();
+  static auto &pool = []() -> model::storage_pool & {
+    std::filesystem::remove(path);
+    static model::storage_pool pool(path, model::storage_options::from_env());
+    service::user users(pool);
+    service::bucket bucket_service(pool);
+    service::artifact artifact_service(pool);
+    model::user user{.name = "bench",
+                     .email = "bench@xbucket",
+                     .password = "bench"};
+    users.insert(user);
+    for (int b = 0; b < buckets; b++) {
+      model::bucket bucket{.name = "bucket" + std::to_string(b),
+                           .description = "",
+                           .user_id = user.id};
+      bucket_service.insert(bucket);
+      artifact_service.transaction([&] {
+        for (int i = 0; i < artifacts_per_bucket; i++) {
+          model::artifact artifact{
+              .name = "file" + std::to_string(i),
+              .filename = std::to_string(b) + "-" + std::to_string(i),
+              .original_filename = "file" + std::to_string(i) + ".bin",
+              .bucket_id = bucket.id};
+          artifact_service.insert(artifact);
+        }
+        return true;
+      });
+    }
+    return pool;
+  }();
+  return pool;
+}
+
+void BM_service_bucket_get(benchmark::State &state) {
+  service::bucket service(seeded_pool());
+  int id = 0;
+  for (auto _ : state) {
+    benchmark::DoNotOptimize(service.get_with_user(id++ % buckets + 1, 1));
+  }
+}
+BENCHMARK(BM_service_bucket_get);
+
+void BM_service_artifact_get(benchmark::State &state) {
+  service::artifact service(seeded_pool());
+  int id = 0;
+  for (auto _ : state) {
+    id = id % (buckets * artifacts_per_bucket) + 1;
+    benchmark::DoNotOptimize(service.get_with_bucket_and_user(
+        id, (id - 1) / artifacts_per_bucket + 1, 1));
+  }
+}
+BENCHMARK(BM_service_artifact_get);
+
+/// a page deep into a bucket costs what the first one does
+void BM_service_artifact_list(benchmark::State &state) {
+  service::artifact service(seeded_pool());
+  const int after = state.range(0);
+  for (auto _ : state) {
+    benchmark::DoNotOptimize(service.list(1, after, "", 100));
+  }
+}
+BENCHMARK(BM_service_artifact_list)->Arg(0)->Arg(artifacts_per_bucket - 200);
+
+void BM_service_login(benchmark::State &state) {
+  service::user service(seeded_pool());
+  for (auto _ : state) {
+    benchmark::DoNotOptimize(service.get_login("bench@xbucket", "bench"));
+  }
+}
+BENCHMARK(BM_service_login);
+} // namespace
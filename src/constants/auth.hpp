@@ -0,0 +1,15 @@
+#pragma once
+
+namespace constants {
+namespace auth {
+/// `session`, `token` or `both`
+constexpr auto mode = "both";         // XBUCKET_AUTH_MODE
+constexpr int token_lifetime = 3600;  // XBUCKET_TOKEN_LIFETIME (seconds)
+/// scopes a token gets when none are requested
+constexpr auto default_scopes = "read,write";
+/// seconds a presigned url is valid when the caller asks for no lifetime,
+/// and the most it can ask for
+constexpr int presign_lifetime = 15 * 60;
+constexpr int max_presign_lifetime = 7 * 24 * 3600;
+} // namespace auth
+} // namespace constants
@@ -0,0 +1,10 @@
+#pragma once
+#include <cstddef>
+
+namespace constants {
+namespace compression {
+/// smallest body compressed per request, below it the coding overhead and
+/// cpu time outweigh the savings
+constexpr std::size_t threshold = 1024; // XBUCKET_COMPRESSION_THRESHOLD
+} // namespace compression
+} // namespace constants
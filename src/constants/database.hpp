@@ -0,0 +1,13 @@
+#pragma once
+#include <cstdint>
+
+namespace constants {
+namespace database {
+/// defaults for the connection pragmas, each can be overridden with the
+/// environment variable named after it (see model::storage_options)
+constexpr auto synchronous = "NORMAL";    // XBUCKET_DB_SYNCHRONOUS
+constexpr std::int64_t mmap_size = 256ll << 20; // XBUCKET_DB_MMAP_SIZE
+constexpr int cache_size = -64 * 1024;    // XBUCKET_DB_CACHE_SIZE (KiB if < 0)
+constexpr int busy_timeout = 5000;        // XBUCKET_DB_BUSY_TIMEOUT (ms)
+} // namespace database
+} // namespace constants
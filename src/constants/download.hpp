@@ -0,0 +1,15 @@
+#pragma once
+#include <cstddef>
+
+namespace constants {
+namespace download {
+/// largest total of the ranges assembled into a multipart/byteranges
+/// response, which is built in memory; larger sets get the whole file.
+/// Single ranges are sent from a file whatever their size
+constexpr std::size_t max_range_size = 16 * 1024 * 1024;
+/// how much of a file the page cache is warmed with before crow reads it
+constexpr std::size_t readahead_size = 4 * 1024 * 1024;
+/// ranges a single request may ask for, larger sets get the whole file
+constexpr std::size_t max_ranges = 16;
+} // namespace download
+} // namespace constants
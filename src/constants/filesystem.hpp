@@ -6,6 +6,7 @@ constexpr auto xbucket_dir = "xdir/";
 constexpr auto xbucket_db_dir = "xdir/db/";
 constexpr auto xbucket_sessions_dir = "xdir/sessions/";
 constexpr auto xbucket_uploads_dir = "xdir/uploads/";
+constexpr auto xbucket_derivatives_dir = "xdir/derivatives/";
 constexpr auto xbucket_db_name = "xbucket.sqlite";
 } // namespace filesystem
 } // namespace constants
@@ -0,0 +1,36 @@
+#pragma once
+#include <cstdint>
+
+namespace constants {
+namespace image {
+/// encoder threads, 0 picks half the cores
+constexpr int workers = 0;      // XBUCKET_IMAGE_WORKERS
+/// transforms waiting for a worker before requests are turned away
+constexpr int queue_size = 64;  // XBUCKET_IMAGE_QUEUE_SIZE
+/// largest width or height a transform may ask for
+constexpr int max_dimension = 4096;
+/// sources above this size are not decoded
+constexpr std::uint64_t max_source_size = 64ull << 20;
+/// nor sources with more pixels, a small compressed file can decode to
+/// gigabytes
+constexpr std::int64_t max_pixels = 50'000'000;
+constexpr int default_quality = 80;
+/// bytes of derivatives kept on disk before the least recently served go
+constexpr std::int64_t cache_size = 1ll << 30; // XBUCKET_IMAGE_CACHE_SIZE
+/// least recently served entries read per eviction query
+constexpr int eviction_batch = 16;
+/// renditions a bucket can ask to have generated for every uploaded image,
+/// see util::image::rendition
+constexpr const char *renditions[] = {"thumb", "medium", "webp"};
+/// storage policies a bucket can apply to uploaded jpeg and png images, see
+/// util::image::recompress
+constexpr const char *compressions[] = {"lossless", "lossy", "webp"};
+constexpr int default_compression_quality = 85;
+/// threads generating renditions after uploads, and the uploads that may
+/// wait for them before further ones are left to be rendered on first view
+constexpr int rendition_workers = 1; // XBUCKET_RENDITION_WORKERS
+constexpr int rendition_queue_size = 256; // XBUCKET_RENDITION_QUEUE_SIZE
+/// a cache hit records its access time at most this often (seconds)
+constexpr int cache_touch_interval = 60;
+} // namespace image
+} // namespace constants
@@ -0,0 +1,10 @@
+#pragma once
+
+namespace constants {
+namespace listing {
+/// items per page when the request doesn't say
+constexpr int page_size = 100;
+/// largest page a request can ask for
+constexpr int max_page_size = 1000;
+} // namespace listing
+} // namespace constants
@@ -0,0 +1,16 @@
+#pragma once
+
+namespace constants {
+namespace reclaim {
+/// seconds between passes over released blobs
+constexpr int interval = 10; // XBUCKET_RECLAIM_INTERVAL
+/// blobs unlinked per transaction, a full batch starts the next one at once
+constexpr int batch = 256;
+/// seconds between reconciliations of the upload and derivative
+/// directories with the database, 0 disables them
+constexpr int gc_interval = 3600; // XBUCKET_GC_INTERVAL
+/// seconds a file must be untouched before it counts as an orphan, covers
+/// uploads still being staged
+constexpr int grace = 3600;
+} // namespace reclaim
+} // namespace constants
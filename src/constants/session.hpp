@@ -0,0 +1,15 @@
+#pragma once
+
+namespace constants {
+namespace session {
+/// independently locked parts of the session store
+constexpr int shards = 16;
+/// seconds a session lives after its last request
+constexpr int lifetime = 7 * 24 * 3600; // XBUCKET_SESSION_LIFETIME
+/// seconds between snapshots to disk, 0 keeps sessions in memory only
+constexpr int snapshot_interval = 60; // XBUCKET_SESSION_SNAPSHOT_INTERVAL
+/// seconds between sweeps of expired sessions
+constexpr int sweep_interval = 60;
+constexpr auto snapshot_name = "sessions.json";
+} // namespace session
+} // namespace constants
@@ -0,0 +1,11 @@
+#pragma once
+#include <cstddef>
+
+namespace constants {
+namespace upload {
+/// size of the slices fed to the multipart parser and written to disk
+constexpr std::size_t chunk_size = 64 * 1024;
+/// upper bound for the headers block of a single multipart part
+constexpr std::size_t max_part_headers_size = 16 * 1024;
+} // namespace upload
+} // namespace constants
@@ -1,7 +1,21 @@
 #pragma once
+#include "../constants/auth.hpp"
+#include "../constants/download.hpp"
+#include "../constants/image.hpp"
 #include "../middleware/auth.hpp"
 #include "../model/model.hpp"
 #include "../service/artifact.hpp"
+#include "../service/derivative.hpp"
+#include "../util/crc32c.hpp"
+#include "../util/download.hpp"
+#include "../util/env.hpp"
+#include "../util/http.hpp"
+#include "../util/image.hpp"
+#include "../util/metrics.hpp"
+#include "../util/multipart.hpp"
+#include "../util/presign.hpp"
+#include "../util/sha256.hpp"
+#include "../util/worker_pool.hpp"
 #include "controller.internal.hpp"
 #include "crow/common.h"
 #include "crow/http_request.h"
@@ -10,35 +24,70 @@
 #include "crow/logging.h"
 #include "crow/utility.h"
 #include <algorithm>
+#include <atomic>
+#include <cerrno>
+#include <cstdint>
+#include <cstdlib>
 #include <crow/app.h>
-#include <crow/multipart.h>
-#include <ctime>
+#include <crow/mime_types.h>
 #include <exception>
 #include <filesystem>
+#include <fstream>
 #include <functional>
+#include <memory>
 #include <optional>
 #include <stdexcept>
 #include <string>
+#include <string_view>
 #include <system_error>
+#include <unistd.h>
+#include <vector>
 
 namespace controller {
-using Session = crow::SessionMiddleware<crow::FileStore>;
 template <typename S, typename... M> class artifact : public controller {
   crow::Crow<M...> &app;
   service::artifact<S> &service;
+  service::derivative<S> &derivatives;
+  /// image transforms run here, off the crow io threads
+  util::worker_pool encoders{
+      static_cast<std::size_t>(util::env::get_or(
+          "XBUCKET_IMAGE_WORKERS", constants::image::workers)),
+      static_cast<std::size_t>(util::env::get_or(
+          "XBUCKET_IMAGE_QUEUE_SIZE", constants::image::queue_size))};
+  /// renditions of new uploads, kept apart so they never delay a viewer
+  util::worker_pool renderers{
+      static_cast<std::size_t>(util::env::get_or(
+          "XBUCKET_RENDITION_WORKERS", constants::image::rendition_workers)),
+      static_cast<std::size_t>(
+          util::env::get_or("XBUCKET_RENDITION_QUEUE_SIZE",
+                            constants::image::rendition_queue_size))};
 
 public:
-  artifact(crow::Crow<M...> &app, service::artifact<S> &service)
-      : service(service), app(app) {
-    controller_register_api_route_auth_io(
+  artifact(crow::Crow<M...> &app, service::artifact<S> &service,
+           service::derivative<S> &derivatives)
+      : service(service), derivatives(derivatives), app(app) {
+    // requests are encoded in parallel already, one thread each is enough
+    cv::setNumThreads(1);
+    util::image::limit_decoder();
+    controller_register_api_route_auth_io_async(
         artifact, "read", EMPTY,
-        "Read artifact's metadata or download its file (if dl==true). (path: "
-        "id<int>, bucket_id<int>, "
-        "dl<bool?>)",
+        "Read artifact's metadata or download its file (if dl==true), "
+        "downloads honour Range, If-Range, If-None-Match and "
+        "If-Modified-Since. Images can be downloaded resized or converted "
+        "(path: id<int>, bucket_id<int>, dl<bool?>, width<int?>, "
+        "height<int?>, fit<contain|cover|fill?>, format<jpeg|png|webp?>, "
+        "quality<1-100?>, rendition<thumb|medium|webp?>)",
         "GET"_method, read, {}, model::artifact::to_json_sample());
     controller_register_api_route_auth_io(
+        artifact, "list", "/list",
+        "List the bucket's artifacts in id order, pass the returned next as "
+        "after for the following page (path: bucket_id<int>, after<int?>, "
+        "prefix<string?> name prefix, limit<int?> 1-1000)",
+        "GET"_method, list, {}, list_sample());
+    controller_register_api_route_auth_io_async(
         artifact, "create", EMPTY,
-        "Create artifacts from multipart upload. "
+        "Create artifacts from multipart upload, parts may carry "
+        "X-Checksum-Sha256/X-Checksum-Crc32c headers to be verified. "
         "(path: bucket_id<int>)",
         "POST"_method, create, {}, model::artifact::to_json_sample());
     // controller_register_api_route_auth(artifact, "update", EMPTY,
@@ -46,79 +95,250 @@ public:
     //                                    update);
     controller_register_api_route_auth(
         artifact, "remove", EMPTY,
-        "Remove artifact (path: id<int>, bucket_id<int>)", "DELETE"_method,
+        "Remove artifact, with recursive=true also the artifacts below it: "
+        "the other parts of its upload and kept originals (path: id<int>, "
+        "bucket_id<int>, recursive<bool>?)",
+        "DELETE"_method,
         remove);
+    controller_register_api_route_auth_io(
+        artifact, "presign_download", "/presign/download",
+        "Issue a url that downloads the artifact without authentication "
+        "until it expires (path: id<int>, bucket_id<int>, expires<int?> "
+        "seconds)",
+        "POST"_method, presign_download, {}, presign_sample());
+    controller_register_api_route_auth_io(
+        artifact, "presign_upload", "/presign/upload",
+        "Issue a url that accepts multipart uploads into the bucket without "
+        "authentication until it expires (path: bucket_id<int>, "
+        "expires<int?> seconds)",
+        "POST"_method, presign_upload, {}, presign_sample());
+    controller_register_api_route_async(
+        artifact, "signed_download", "/signed",
+        "Download through a presigned url, same conditional and Range "
+        "support as read (path: sig<string>)",
+        "GET"_method, signed_download);
+    controller_register_api_route_async(
+        artifact, "signed_upload", "/signed",
+        "Create artifacts through a presigned url (path: sig<string>)",
+        "POST"_method, signed_upload);
   }
 
-  std::string get_random_filename(std::string prefix,
-                                  std::string original_filename) {
-    constexpr auto salts = 10000;
-    return prefix + std::to_string(rand() % salts + salts) +
-           std::string{original_filename.begin() + original_filename.rfind("."),
-                       original_filename.end()};
-  }
-
-  std::vector<model::artifact> get_multipart_uploads(const crow::request &req) {
-    std::vector<model::artifact> artifacts;
-    auto bucket_id = atoi(get_param(req, "bucket_id").c_str());
-    crow::multipart::message file_message(req);
-    for (const auto &part : file_message.part_map) {
-      const auto &part_name = part.first;
-      const auto &part_value = part.second;
-      // Extract the file name
-      auto headers_it = part_value.headers.find("Content-Disposition");
-      if (headers_it == part_value.headers.end()) {
-        throw std::runtime_error("No Content-Disposition found");
-      }
-      auto params_it = headers_it->second.params.find("filename");
-      if (params_it == headers_it->second.params.end()) {
-        throw std::runtime_error("Part with name " + part_name +
-                                 " should have a file");
-      }
-      const std::string outfile_name = get_random_filename(
-          req.remote_ip_address + "." + std::to_string(bucket_id) + "." +
-              std::to_string((int)time(NULL)),
-          params_it->second);
-
-      // Create a new file with the extracted file name and write file contents
-      // to it
-      std::ofstream out_file(constants::filesystem::xbucket_uploads_dir +
-                             outfile_name);
-      if (!out_file) {
-        throw std::runtime_error("Write to file failed\n");
-        continue;
+  static crow::json::wvalue list_sample() {
+    auto sample = crow::json::wvalue::list{model::artifact::to_json_sample()};
+    return crow::json::wvalue{{"items", sample}, {"next", "int?"}};
+  }
+
+  crow::response list(const crow::request &req) {
+    auto bucket_id = std::atoi(get_param(req, "bucket_id").c_str());
+    auto user_id = app.template get_context<middleware::auth>(req).user_id;
+    if (!service.owns_bucket(bucket_id, user_id)) {
+      return crow::response{crow::status::NOT_FOUND};
+    }
+    auto page = get_page_request(req);
+    auto items =
+        service.list(bucket_id, page.after, page.prefix, page.limit + 1);
+    return page_response(items, page.limit);
+  }
+
+  static std::string get_mime_type(const std::string &filename) {
+    auto dot = filename.rfind('.');
+    if (dot != std::string::npos) {
+      auto it = crow::mime_types.find(filename.substr(dot + 1));
+      if (it != crow::mime_types.end()) {
+        return it->second;
       }
-      out_file << part_value.body;
+    }
+    return "application/octet-stream";
+  }
+
+  /// Creates an empty staging file in the uploads dir, mkstemp picks a name
+  /// no other upload holds, so concurrent parts never share a file
+  static std::string create_staged_file() {
+    std::string path =
+        std::string(constants::filesystem::xbucket_uploads_dir) +
+        ".staged.XXXXXX";
+    auto fd = mkstemp(path.data());
+    if (fd == -1) {
+      throw write_error(path);
+    }
+    ::close(fd);
+    return path;
+  }
+
+  struct upload {
+    model::artifact artifact;
+    std::string staged_path;
+    /// the file as sent, when a bucket policy recompressed it and keeps
+    /// originals
+    std::optional<model::artifact> original;
+    std::string original_path;
+  };
+
+  std::vector<upload> get_multipart_uploads(const crow::request &req,
+                                            int bucket_id) {
+    std::vector<upload> uploads;
+    std::ofstream out_file;
+    util::sha256 hash;
+    util::crc32c checksum;
+    util::multipart::part current_part;
+    try {
+      util::multipart::parser parser(
+          util::multipart::get_boundary(req.get_header_value("Content-Type")),
+          [&](const util::multipart::part &part) {
+            if (part.filename.empty()) {
+              throw std::runtime_error("Part with name " + part.name +
+                                       " should have a file");
+            }
+            current_part = part;
+            // Parts are staged under a unique name until their content hash
+            // is known, the body is written to it as the parser releases it
+            const std::string staged_path = create_staged_file();
+            uploads.push_back(
+                {.artifact = model::artifact{.name = part.name,
+                                             .original_filename = part.filename,
+                                             .bucket_id = bucket_id},
+                 .staged_path = staged_path});
+            hash = util::sha256{};
+            checksum = util::crc32c{};
+            out_file.open(staged_path, std::ios::binary);
+            if (!out_file) {
+              throw write_error(staged_path);
+            }
+          },
+          [&](std::string_view data) {
+            hash.update(data);
+            checksum.update(data);
+            if (!out_file.write(data.data(), data.size())) {
+              throw write_error(uploads.back().staged_path);
+            }
+          },
+          [&] {
+            out_file.close();
+            auto &artifact = uploads.back().artifact;
+            artifact.sha256 = artifact.filename = hash.hex_digest();
+            artifact.crc32c = checksum.hex_digest();
+            verify_checksum(current_part, "x-checksum-sha256", artifact.sha256);
+            verify_checksum(current_part, "x-checksum-crc32c", artifact.crc32c);
+          });
+      // crow has already read the whole body into req.body, nothing here is
+      // streamed; slicing it only keeps the parser's own buffers small
+      std::string_view body = req.body;
+      for (std::size_t offset = 0; offset < body.size();
+           offset += constants::upload::chunk_size) {
+        parser.feed(body.substr(offset, constants::upload::chunk_size));
+      }
+      parser.finish();
+    } catch (std::runtime_error &e) {
       out_file.close();
+      discard_uploads(uploads);
+      throw;
+    }
+    return uploads;
+  }
+
+  /// checks a digest sent by the client in the part headers (hex encoded)
+  static void verify_checksum(const util::multipart::part &part,
+                              const std::string &header,
+                              const std::string &computed) {
+    auto it = part.headers.find(header);
+    if (it != part.headers.end() &&
+        util::multipart::to_lower(it->second.value) != computed) {
+      throw std::runtime_error("Checksum mismatch (" + header + ") for part " +
+                               part.name);
+    }
+  }
+
+  /// a staged file that could not be written, the disk is full or not ours
+  static std::filesystem::filesystem_error
+  write_error(const std::string &path) {
+    return {"Write to file failed", path,
+            std::error_code(errno ? errno : EIO, std::generic_category())};
+  }
+
+  /// disk errors are ours, not the client's
+  static crow::response
+  storage_failed(const std::filesystem::filesystem_error &e) {
+    CROW_LOG_ERROR << "Failed to store upload: " << e.what();
+    crow::json::wvalue error;
+    error["error"] = "Failed to store the upload";
+    return crow::response{crow::status::INTERNAL_SERVER_ERROR, error};
+  }
 
-      artifacts.push_back(
-          model::artifact{.name = part_name,
-                          .filename = outfile_name,
-                          .original_filename = params_it->second,
-                          .bucket_id = bucket_id});
+  /// removes staged files that did not make it into the blob store
+  void discard_uploads(const std::vector<upload> &uploads) {
+    for (const auto &upload : uploads) {
+      std::error_code ec;
+      std::filesystem::remove(upload.staged_path, ec);
+      if (upload.original) {
+        std::filesystem::remove(upload.original_path, ec);
+      }
+    }
+  }
+
+  /// Applies the bucket's compression policy to the staged images, their
+  /// artifacts then describe the recompressed content
+  void recompress(const model::bucket &bucket, std::vector<upload> &uploads) {
+    for (auto &upload : uploads) {
+      auto &artifact = upload.artifact;
+      auto format = util::image::format_of(artifact.original_filename);
+      std::optional<util::image::recompressed> result;
+      try {
+        result = util::image::recompress(upload.staged_path, format,
+                                         bucket.compression,
+                                         bucket.compression_quality);
+      } catch (util::image::too_large &e) {
+        throw;
+      } catch (std::exception &e) {
+        CROW_LOG_WARNING << "Failed to recompress " << artifact.original_filename
+                         << ": " << e.what();
+      }
+      if (!result) {
+        continue;
+      }
+      auto path = upload.staged_path + "." + result->format;
+      std::ofstream file(path, std::ios::binary | std::ios::trunc);
+      if (!file.write(result->data.data(), result->data.size())) {
+        throw write_error(path);
+      }
+      file.close();
+      auto original = artifact;
+      artifact.sha256 = artifact.filename =
+          util::sha256::hex_digest(result->data);
+      artifact.crc32c = util::crc32c{}.update(result->data).hex_digest();
+      if (result->format != format) {
+        auto dot = artifact.original_filename.rfind('.');
+        artifact.original_filename =
+            artifact.original_filename.substr(0, dot) + "." + result->format;
+      }
+      if (bucket.keep_original) {
+        upload.original = std::move(original);
+        upload.original_path = upload.staged_path;
+      } else {
+        std::error_code ec;
+        std::filesystem::remove(upload.staged_path, ec);
+      }
+      upload.staged_path = path;
     }
-    return artifacts;
   }
 
   std::vector<crow::json::wvalue>
-  store_artifacts_from_uploads(std::vector<model::artifact> &artifacts,
-                               std::function<int(model::artifact &)> callback) {
+  store_artifacts_from_uploads(std::vector<upload> &uploads,
+                               std::function<int(upload &)> callback) {
     auto response_vector = std::vector<crow::json::wvalue>{};
-    if (artifacts.size()) {
-      std::reference_wrapper<model::artifact> first_artifact =
-          artifacts.front();
-      model::get_storage().transaction([&] mutable {
+    if (uploads.size()) {
+      std::reference_wrapper<upload> first_upload = uploads.front();
+      service.transaction([&] mutable {
         try {
-          callback(first_artifact.get());
-          response_vector.push_back(first_artifact.get().to_json());
-          for (auto it = artifacts.begin() + 1; it < artifacts.end(); it++) {
-            it->super = first_artifact.get().id;
+          callback(first_upload.get());
+          response_vector.push_back(first_upload.get().artifact.to_json());
+          for (auto it = uploads.begin() + 1; it < uploads.end(); it++) {
+            it->artifact.super = first_upload.get().artifact.id;
             callback(*it);
-            response_vector.push_back(it->to_json());
+            response_vector.push_back(it->artifact.to_json());
           }
           return true;
         } catch (std::system_error &e) {
-          throw e;
+          throw;
           return false;
         }
       });
@@ -126,64 +346,575 @@ public:
     return response_vector;
   }
 
-  crow::response create(const crow::request &req) {
-    auto artifacts = get_multipart_uploads(req);
+  /// images a bucket compression policy applies to
+  static bool has_images(const std::vector<upload> &uploads) {
+    return std::any_of(uploads.begin(), uploads.end(), [](const upload &u) {
+      return !util::image::format_of(u.artifact.original_filename).empty();
+    });
+  }
+
+  /// stores the staged uploads as artifacts and queues their renditions
+  crow::response store(const std::optional<model::bucket> &bucket,
+                       std::vector<upload> &uploads) {
     auto response = crow::json::wvalue{};
-    if (artifacts.empty()) {
-      response["error"] = "No multipart file provied";
-      return crow::response{crow::status::BAD_REQUEST, response};
-    }
     try {
-      auto stored_artifacts = store_artifacts_from_uploads(
-          artifacts, [this](model::artifact &artifact) {
-            return service.insert(artifact);
+      auto stored_artifacts =
+          store_artifacts_from_uploads(uploads, [this](upload &upload) {
+            auto id = service.insert(upload.artifact, upload.staged_path);
+            if (upload.original) {
+              upload.original->super = id;
+              service.insert(*upload.original, upload.original_path);
+            }
+            return id;
           });
+      if (bucket) {
+        render(*bucket, uploads);
+      }
       response = std::move(stored_artifacts);
       return response;
+    } catch (std::filesystem::filesystem_error &e) {
+      discard_uploads(uploads);
+      return storage_failed(e);
     } catch (std::system_error &e) {
+      discard_uploads(uploads);
       response["error"] = "Bucket not found";
       return crow::response{crow::status::NOT_FOUND, response};
     }
   }
 
+  void create(const crow::request &req, crow::response &res) {
+    create(req, res, atoi(get_param(req, "bucket_id").c_str()));
+  }
+
+  /// Stores the uploaded parts. Images under a bucket compression policy are
+  /// recompressed and stored on the encoder pool, `res` is then ended back
+  /// on the connection's io thread; a full queue is answered with 503
+  void create(const crow::request &req, crow::response &res, int bucket_id) {
+    auto uploading = std::make_shared<util::metrics::gauge::hold>(
+        util::metrics::registry::instance().uploading, req.body.size());
+    std::vector<upload> uploads;
+    try {
+      uploads = get_multipart_uploads(req, bucket_id);
+    } catch (std::filesystem::filesystem_error &e) {
+      res = storage_failed(e);
+      res.end();
+      return;
+    }
+    if (uploads.empty()) {
+      crow::json::wvalue error;
+      error["error"] = "No multipart file provied";
+      res = crow::response{crow::status::BAD_REQUEST, error};
+      res.end();
+      return;
+    }
+    auto bucket = service.get_bucket(bucket_id);
+    if (!bucket || bucket->compression.empty() || !has_images(uploads)) {
+      res = store(bucket, uploads);
+      res.end();
+      return;
+    }
+    auto io_service = req.io_service;
+    auto queued = encoders.try_submit([this, &res, io_service, uploading,
+                                       bucket, uploads] mutable {
+      crow::response result;
+      try {
+        recompress(*bucket, uploads);
+        result = store(bucket, uploads);
+      } catch (util::image::too_large &e) {
+        discard_uploads(uploads);
+        crow::json::wvalue error;
+        error["error"] = e.what();
+        result = crow::response{crow::status::PAYLOAD_TOO_LARGE, error};
+      } catch (std::filesystem::filesystem_error &e) {
+        discard_uploads(uploads);
+        result = storage_failed(e);
+      } catch (std::exception &e) {
+        discard_uploads(uploads);
+        crow::json::wvalue error;
+        error["error"] = e.what();
+        result = crow::response{crow::status::BAD_REQUEST, error};
+      }
+      asio::post(*io_service, [&res, result = std::move(result)]() mutable {
+        res = std::move(result);
+        res.end();
+      });
+    });
+    if (!queued) {
+      discard_uploads(uploads);
+      res.code = crow::status::SERVICE_UNAVAILABLE;
+      res.set_header("Retry-After", "1");
+      res.end();
+    }
+  }
+
   crow::response update(const crow::request &req) {
     auto new_artifact = model::artifact::from_json(crow::json::load(req.body));
     auto id = std::atoi(get_param(req, "id").c_str());
     if (auto old_artifact = service.get_with_bucket_and_user(
             new_artifact.id, new_artifact.bucket_id,
-            app.template get_context<Session>(req).get("id", -1))) {
+            app.template get_context<middleware::auth>(req).user_id)) {
       new_artifact.created_at = old_artifact.value().created_at;
-      service.update(new_artifact);
+      service.immediate_transaction([&] {
+        service.update(new_artifact);
+        return true;
+      });
       return crow::response{new_artifact.to_json()};
     }
     return crow::response{crow::status::NOT_FOUND};
   }
 
-  crow::response read(const crow::request &req) {
+  /// strong validator: the content hash, or the stored file name and
+  /// modification time for artifacts uploaded before hashes were kept
+  static std::string get_etag(const model::artifact &artifact) {
+    if (!artifact.sha256.empty()) {
+      return "\"" + artifact.sha256 + "\"";
+    }
+    return "\"" +
+           util::sha256::hex_digest(artifact.filename + artifact.updated_at)
+               .substr(0, 32) +
+           "\"";
+  }
+
+  static bool is_not_modified(const crow::request &req, const std::string &etag,
+                              std::optional<std::int64_t> last_modified) {
+    auto if_none_match = req.get_header_value("If-None-Match");
+    if (!if_none_match.empty()) {
+      return util::http::etag_list_matches(if_none_match, etag);
+    }
+    auto if_modified_since =
+        util::http::parse_date(req.get_header_value("If-Modified-Since"));
+    return last_modified && if_modified_since &&
+           *last_modified <= *if_modified_since;
+  }
+
+  /// a Range is only honoured if If-Range (when sent) still matches
+  static bool is_range_current(const crow::request &req,
+                               const std::string &etag,
+                               std::optional<std::int64_t> last_modified) {
+    auto if_range = req.get_header_value("If-Range");
+    if (if_range.empty()) {
+      return true;
+    }
+    if (if_range.front() == '"') {
+      return if_range == etag;
+    }
+    auto date = util::http::parse_date(if_range);
+    return date && last_modified && *date == *last_modified;
+  }
+
+  /// appends the bytes of `range` to `dest`
+  static void read_range(std::ifstream &source,
+                         const util::http::byte_range &range,
+                         std::string &dest) {
+    const auto offset = dest.size();
+    dest.resize(offset + range.size());
+    if (!source.seekg(range.first) ||
+        !source.read(dest.data() + offset, range.size())) {
+      throw std::runtime_error("Read from file failed");
+    }
+  }
+
+  /// Answers with the artifact's file and ends `res`. Whole files and single
+  /// ranges are sent by crow from a file, multiple ranges are assembled as
+  /// multipart/byteranges unless they add up to more than max_range_size,
+  /// then the whole file is sent instead.
+  void download(const crow::request &req, crow::response &res,
+                const model::artifact &artifact) {
+    const auto path = service::blob<S>::path(artifact.filename);
+    std::error_code ec;
+    const std::uint64_t size = std::filesystem::file_size(path, ec);
+    if (ec) {
+      CROW_LOG_ERROR << "Artifact file missing: " << artifact.filename;
+      res = crow::response{crow::status::NOT_FOUND};
+      res.end();
+      return;
+    }
+    // blobs are stored without extension, the type comes from the uploaded
+    // file name
+    const auto content_type = get_mime_type(artifact.original_filename);
+    const auto etag = get_etag(artifact);
+    const auto last_modified =
+        util::http::parse_sql_datetime(artifact.updated_at);
+
+    res = crow::response{};
+    res.set_header("ETag", etag);
+    res.set_header("Accept-Ranges", "bytes");
+    if (last_modified) {
+      res.set_header("Last-Modified", util::http::format_date(*last_modified));
+    }
+    if (is_not_modified(req, etag, last_modified)) {
+      res.code = crow::status::NOT_MODIFIED;
+      res.end();
+      return;
+    }
+
+    auto range = util::http::parse_range(req.get_header_value("Range"), size);
+    if (!is_range_current(req, etag, last_modified)) {
+      range.result = util::http::range_request::status::none;
+    }
+    std::uint64_t total = 0;
+    for (const auto &r : range.ranges) {
+      total += r.size();
+    }
+    // a set of ranges too large to assemble is answered with the whole file,
+    // as a server may ignore Range
+    if (range.result == util::http::range_request::status::satisfiable &&
+        range.ranges.size() > 1 &&
+        total > constants::download::max_range_size) {
+      range.result = util::http::range_request::status::none;
+    }
+    switch (range.result) {
+    case util::http::range_request::status::none:
+      // whole file: crow opens and streams it itself, warm the page cache
+      // for its reads
+      util::download::will_read(path, 0, size);
+      res.set_static_file_info(path);
+      res.set_header("Content-Type", content_type);
+      res.end();
+      return;
+    case util::http::range_request::status::unsatisfiable:
+      res.code = crow::status::RANGE_NOT_SATISFIABLE;
+      res.set_header("Content-Range", "bytes */" + std::to_string(size));
+      res.end();
+      return;
+    case util::http::range_request::status::satisfiable:
+      break;
+    }
+
+    auto content_range = [size](const util::http::byte_range &r) {
+      return "bytes " + std::to_string(r.first) + "-" +
+             std::to_string(r.last) + "/" + std::to_string(size);
+    };
+    if (range.ranges.size() == 1) {
+      if (!send_range(req, res, path, size, range.ranges.front())) {
+        res = crow::response{crow::status::INTERNAL_SERVER_ERROR};
+        res.end();
+        return;
+      }
+      res.set_header("Content-Type", content_type);
+      res.set_header("Content-Range", content_range(range.ranges.front()));
+      res.end();
+      return;
+    }
+
+    std::ifstream source(path, std::ios::binary);
+    res.code = crow::status::PARTIAL_CONTENT;
+    // unique per response without rand(), which isn't safe across threads
+    static std::atomic<std::uint64_t> responses = 0;
+    const auto boundary =
+        util::sha256::hex_digest(etag + "-" + std::to_string(responses++))
+            .substr(0, 24);
+    res.set_header("Content-Type",
+                   "multipart/byteranges; boundary=" + boundary);
+    res.body.reserve(total + range.ranges.size() * 256);
+    for (const auto &r : range.ranges) {
+      res.body += "\r\n--" + boundary + "\r\nContent-Type: " + content_type +
+                  "\r\nContent-Range: " + content_range(r) + "\r\n\r\n";
+      read_range(source, r, res.body);
+    }
+    res.body += "\r\n--" + boundary + "--\r\n";
+    res.end();
+  }
+
+  /// Points `res` at the bytes of `range` as a 206, without holding them in
+  /// memory: crow only sends whole files, so a range short of the whole
+  /// blob is copied to a staged file by the kernel and that file is sent.
+  /// The staged file is unlinked once crow has opened it, reclaimer::collect
+  /// removes any left behind. False when the range could not be staged.
+  bool send_range(const crow::request &req, crow::response &res,
+                  const std::string &path, std::uint64_t size,
+                  const util::http::byte_range &range) {
+    if (range.size() == size) {
+      util::download::will_read(path, 0, size);
+      res.set_static_file_info(path);
+      res.code = crow::status::PARTIAL_CONTENT;
+      return true;
+    }
+    std::string staged;
+    try {
+      staged = create_staged_file();
+      util::download::copy_range(path, range, staged);
+    } catch (std::filesystem::filesystem_error &e) {
+      std::error_code ec;
+      std::filesystem::remove(staged, ec);
+      CROW_LOG_ERROR << "Failed to stage range: " << e.what();
+      return false;
+    }
+    res.set_static_file_info(staged);
+    // set_static_file_info answers 200
+    res.code = crow::status::PARTIAL_CONTENT;
+    // crow opens the file while the response is ended on this io thread,
+    // by the time this runs it no longer needs the name
+    asio::post(*req.io_service, [staged] {
+      std::error_code ec;
+      std::filesystem::remove(staged, ec);
+    });
+    return true;
+  }
+
+  /// the transform with its output format settled, sources we can't encode
+  /// back are converted to png
+  static util::image::transform
+  resolve(util::image::transform transform, const model::artifact &artifact) {
+    if (transform.format.empty()) {
+      transform.format = util::image::format_of(artifact.original_filename);
+      if (transform.format.empty()) {
+        transform.format = "png";
+      }
+    }
+    return transform;
+  }
+
+  static std::string get_derivative_key(const model::artifact &artifact,
+                                        const util::image::transform &transform) {
+    return artifact.filename + "-" + transform.key();
+  }
+
+  /// Encodes `transform` of `source` into the derivative cache
+  void generate(const std::string &key, const std::string &source,
+              const util::image::transform &transform) {
+    auto data =
+        util::image::apply(service::blob<S>::path(source), transform);
+    derivatives.store(key, source, util::image::content_type(transform.format),
+                      data);
+  }
+
+  /// Queues the renditions the bucket asks for of the images just stored.
+  /// They land in the derivative cache, so an image's first view is already
+  /// a cache hit; when the queue is full they are left to that first view.
+  void render(const model::bucket &bucket, const std::vector<upload> &uploads) {
+    std::string_view renditions = bucket.renditions;
+    while (!renditions.empty()) {
+      auto comma = renditions.find(',');
+      auto name = renditions.substr(0, comma);
+      renditions.remove_prefix(comma == std::string_view::npos
+                                   ? renditions.size()
+                                   : comma + 1);
+      auto rendition = util::image::transform::rendition(name);
+      if (!rendition) {
+        continue;
+      }
+      for (const auto &upload : uploads) {
+        const auto &artifact = upload.artifact;
+        if (util::image::format_of(artifact.original_filename).empty()) {
+          continue;
+        }
+        auto transform = resolve(*rendition, artifact);
+        auto key = get_derivative_key(artifact, transform);
+        auto queued = renderers.try_submit(
+            [this, key, source = artifact.filename, transform] {
+              if (derivatives.get(key)) {
+                return;
+              }
+              try {
+                generate(key, source, transform);
+              } catch (std::exception &e) {
+                CROW_LOG_WARNING << "Failed to render " << key << ": "
+                                 << e.what();
+              }
+            });
+        if (!queued) {
+          CROW_LOG_WARNING << "Rendition queue full, " << key
+                           << " is rendered on first view";
+        }
+      }
+    }
+  }
+
+  /// Serves the cached derivative, or encodes it on the worker pool, caches
+  /// it and ends `res` back on the connection's io thread. A full queue is
+  /// answered with 503
+  void transform(const crow::request &req, crow::response &res,
+                 const model::artifact &artifact,
+                 util::image::transform transform) {
+    transform = resolve(transform, artifact);
+    auto etag = get_etag(artifact);
+    etag.insert(etag.size() - 1, "-" + transform.key());
+    if (util::http::etag_list_matches(req.get_header_value("If-None-Match"),
+                                      etag)) {
+      res.code = crow::status::NOT_MODIFIED;
+      res.set_header("ETag", etag);
+      res.end();
+      return;
+    }
+    const auto key = get_derivative_key(artifact, transform);
+    // an entry evicted since the lookup is generated again
+    if (auto cached = derivatives.get(key)) {
+      if (auto data = service::derivative<S>::read(key)) {
+        res.body = std::move(*data);
+        res.set_header("Content-Type", cached->content_type);
+        res.set_header("ETag", etag);
+        res.end();
+        return;
+      }
+    }
+    auto io_service = req.io_service;
+    auto path = service::blob<S>::path(artifact.filename);
+    auto source = artifact.filename;
+    auto queued = encoders.try_submit([this, &res, io_service, path, source,
+                                       key, transform, etag] {
+      crow::response result;
+      try {
+        auto content_type = util::image::content_type(transform.format);
+        result.body = util::image::apply(path, transform);
+        try {
+          derivatives.store(key, source, content_type, result.body);
+        } catch (std::exception &e) {
+          CROW_LOG_ERROR << "Failed to cache derivative " << key << ": "
+                         << e.what();
+        }
+        result.set_header("Content-Type", content_type);
+        result.set_header("ETag", etag);
+      } catch (util::image::too_large &e) {
+        crow::json::wvalue error;
+        error["error"] = e.what();
+        result = crow::response{crow::status::PAYLOAD_TOO_LARGE, error};
+      } catch (std::exception &e) {
+        crow::json::wvalue error;
+        error["error"] = e.what();
+        result = crow::response{crow::status::BAD_REQUEST, error};
+      }
+      asio::post(*io_service, [&res, result = std::move(result)]() mutable {
+        res = std::move(result);
+        res.end();
+      });
+    });
+    if (!queued) {
+      res.code = crow::status::SERVICE_UNAVAILABLE;
+      res.set_header("Retry-After", "1");
+      res.end();
+    }
+  }
+
+  void read(const crow::request &req, crow::response &res) {
     auto id = std::atoi(get_param(req, "id").c_str());
     auto bucket_id = std::atoi(get_param(req, "bucket_id").c_str());
     auto download = get_param_or(req, "dl", "false");
+    auto transform = util::image::transform::from_request(req);
     if (auto artifact = service.get_with_bucket_and_user(
             id, bucket_id,
-            app.template get_context<Session>(req).get("id", -1))) {
+            app.template get_context<middleware::auth>(req).user_id)) {
+      if (download == "true" && transform) {
+        return this->transform(req, res, artifact.value(), *transform);
+      }
       if (download == "true") {
-        crow::response res;
-        res.set_static_file_info(constants::filesystem::xbucket_uploads_dir +
-                                 artifact.value().filename);
-        return res;
+        return this->download(req, res, artifact.value());
       }
-      return crow::response{artifact.value().to_json()};
+      res = crow::response{artifact.value().to_json()};
+    } else {
+      res = crow::response{crow::status::NOT_FOUND};
+    }
+    res.end();
+  }
+
+  static crow::json::wvalue presign_sample() {
+    return {{"url", "string"}, {"expires", 0}};
+  }
+
+  const std::string &get_secret() {
+    return app.template get_middleware<middleware::auth>().options.secret;
+  }
+
+  /// expiry of a url asked for with the `expires` path param
+  static std::int64_t get_expires(const crow::request &req) {
+    auto lifetime =
+        std::atoi(get_param_or(req, "expires",
+                               std::to_string(constants::auth::presign_lifetime))
+                      .c_str());
+    if (lifetime <= 0 || lifetime > constants::auth::max_presign_lifetime) {
+      throw std::runtime_error(
+          "expires must be between 1 and " +
+          std::to_string(constants::auth::max_presign_lifetime) + " seconds");
+    }
+    return middleware::auth::now() + lifetime;
+  }
+
+  static crow::json::wvalue signed_url(const std::string &signature,
+                                       std::int64_t expires) {
+    return {{"url", "/api/artifact/signed?sig=" + signature},
+            {"expires", expires}};
+  }
+
+  /// The signature covers what `download` needs: the blob, the uploaded
+  /// file name and the validators, so serving the url reads no row.
+  /// Ownership is checked here. The url grants the content as it was when
+  /// signed until it expires; deleting the artifact stops it once its blob
+  /// is reclaimed, content another artifact shares stays reachable.
+  crow::response presign_download(const crow::request &req) {
+    auto id = std::atoi(get_param(req, "id").c_str());
+    auto bucket_id = std::atoi(get_param(req, "bucket_id").c_str());
+    auto expires = get_expires(req);
+    if (auto artifact = service.get_with_bucket_and_user(
+            id, bucket_id,
+            app.template get_context<middleware::auth>(req).user_id)) {
+      auto signature = util::presign::sign(
+          {"download", artifact->filename, artifact->sha256,
+           artifact->original_filename, artifact->updated_at},
+          expires, get_secret());
+      return crow::response{signed_url(signature, expires)};
     }
     return crow::response{crow::status::NOT_FOUND};
   }
 
+  crow::response presign_upload(const crow::request &req) {
+    auto bucket_id = std::atoi(get_param(req, "bucket_id").c_str());
+    auto expires = get_expires(req);
+    if (!service.owns_bucket(
+            bucket_id, app.template get_context<middleware::auth>(req).user_id)) {
+      return crow::response{crow::status::NOT_FOUND};
+    }
+    auto signature = util::presign::sign(
+        {"upload", std::to_string(bucket_id)}, expires, get_secret());
+    return crow::response{signed_url(signature, expires)};
+  }
+
+  std::optional<std::vector<std::string>>
+  verify_signature(const crow::request &req, const std::string &action,
+                   std::size_t field_count) {
+    auto fields = util::presign::verify(get_param(req, "sig"), get_secret(),
+                                        middleware::auth::now());
+    if (!fields || fields->size() != field_count ||
+        fields->front() != action) {
+      return {};
+    }
+    return fields;
+  }
+
+  /// served from the signed fields alone, see presign_download
+  void signed_download(const crow::request &req, crow::response &res) {
+    auto fields = verify_signature(req, "download", 5);
+    if (!fields) {
+      res.code = crow::status::FORBIDDEN;
+      res.end();
+      return;
+    }
+    download(req, res,
+             model::artifact{.filename = (*fields)[1],
+                             .original_filename = (*fields)[3],
+                             .sha256 = (*fields)[2],
+                             .updated_at = (*fields)[4]});
+  }
+
+  void signed_upload(const crow::request &req, crow::response &res) {
+    auto fields = verify_signature(req, "upload", 2);
+    if (!fields) {
+      res.code = crow::status::FORBIDDEN;
+      res.end();
+      return;
+    }
+    create(req, res, std::atoi((*fields)[1].c_str()));
+  }
+
   crow::response remove(const crow::request &req) {
     auto id = std::atoi(get_param(req, "id").c_str());
     auto bucket_id = std::atoi(get_param(req, "bucket_id").c_str());
     if (auto artifact = service.get_with_bucket_and_user(
             id, bucket_id,
-            app.template get_context<Session>(req).get("id", -1))) {
-      service.remove(artifact.value());
+            app.template get_context<middleware::auth>(req).user_id)) {
+      if (!service.remove(artifact.value(),
+                          get_param_or(req, "recursive", "false") == "true")) {
+        return crow::response{crow::status::INTERNAL_SERVER_ERROR};
+      }
       return crow::response{crow::status::NO_CONTENT};
     }
     return crow::response{crow::status::NOT_FOUND};
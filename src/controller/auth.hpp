@@ -13,9 +13,11 @@
 #include <functional>
 #include <optional>
 #include <stdexcept>
+#include <string>
+#include <vector>
 
 namespace controller {
-using Session = crow::SessionMiddleware<crow::FileStore>;
+using Session = middleware::Session;
 template <typename S, typename... M> class auth : public controller {
   crow::Crow<M...> &app;
   service::user<S> &service;
@@ -29,6 +31,51 @@ public:
         model::auth::from_json_sample(), model::user::to_json_sample());
     controller_register_api_route_auth(auth, "logout", "/logout",
                                        "Session logout", "POST"_method, logout);
+    controller_register_api_route_io(
+        auth, "token", "/token",
+        "Issue a bearer token, scopes default to read and write",
+        "POST"_method, token, token_sample(), token_output_sample());
+  }
+
+  static crow::json::wvalue token_sample() {
+    auto sample = model::auth::from_json_sample();
+    sample["scopes"] = "read,write";
+    return sample;
+  }
+
+  static crow::json::wvalue token_output_sample() {
+    return {{"token", "string"}, {"expires", 0}, {"scopes", "read,write"}};
+  }
+
+  crow::response token(const crow::request &req) {
+    auto &auth = app.template get_middleware<middleware::auth>();
+    if (!auth.options.tokens) {
+      throw std::runtime_error("token authentication is disabled");
+    }
+    auto body = crow::json::load(req.body);
+    auto credentials = model::auth::from_json(body);
+    auto user = service.get_login(credentials.email, credentials.password);
+    if (!user) {
+      return crow::response{crow::status::NOT_FOUND};
+    }
+    auto requested = util::json::get_or<std::string>(
+        body, "scopes", constants::auth::default_scopes);
+    std::vector<std::string> scopes;
+    std::string granted;
+    for (std::string scope : {"read", "write"}) {
+      if (("," + requested + ",").find("," + scope + ",") !=
+          std::string::npos) {
+        scopes.push_back(scope);
+        granted += (granted.empty() ? "" : ",") + scope;
+      }
+    }
+    auto claims = auth.issue(user->id, scopes);
+    crow::json::wvalue result{
+        {"token", auth.sign(claims)},
+        {"expires", claims.expires},
+        {"scopes", granted},
+    };
+    return crow::response{result};
   }
 
   crow::response logout(const crow::request &req) {
@@ -13,7 +13,6 @@
 #include <stdexcept>
 
 namespace controller {
-using Session = crow::SessionMiddleware<crow::FileStore>;
 template <typename S, typename... M> class bucket : public controller {
   crow::Crow<M...> &app;
   service::bucket<S> &service;
@@ -24,6 +23,12 @@ public:
     controller_register_api_route_auth_io(
         bucket, "read", EMPTY, "Read bucket (path: id<int>)", "GET"_method,
         read, {}, model::bucket::to_json_sample());
+    controller_register_api_route_auth_io(
+        bucket, "list", "/list",
+        "List your buckets in id order, pass the returned next as after for "
+        "the following page (path: after<int?>, prefix<string?> name "
+        "prefix, limit<int?> 1-1000)",
+        "GET"_method, list, {}, list_sample());
     controller_register_api_route_auth_io(
         bucket, "create", EMPTY, "Create a new bucket", "POST"_method, create,
         model::bucket::from_json_sample(), model::bucket::to_json_sample());
@@ -31,12 +36,77 @@ public:
         bucket, "update", EMPTY, "Update a bucket (path: id<int>)",
         "PUT"_method, update, model::bucket::from_json_sample(),
         model::bucket::to_json_sample());
-    controller_register_api_route_auth(bucket, "remove", EMPTY, "Remove a bucket","DELETE"_method,remove);
+    controller_register_api_route_auth_io(
+        bucket, "tree", "/tree",
+        "The bucket and all its sub-buckets, at any depth (path: id<int>)",
+        "GET"_method, tree, {}, list_sample());
+    controller_register_api_route_auth_io(
+        bucket, "stats", "/stats",
+        "Bucket, artifact and byte counts of the bucket and all its "
+        "sub-buckets (path: id<int>)",
+        "GET"_method, stats, {}, stats_sample());
+    controller_register_api_route_auth_io(
+        bucket, "usage", "/usage",
+        "Artifact count, content bytes and last write of the bucket, kept "
+        "up to date on every upload and delete (path: id<int>)",
+        "GET"_method, usage, {}, model::bucket_usage::to_json_sample());
+    controller_register_api_route_auth(bucket, "remove", EMPTY, "Remove a bucket, its sub-buckets and their artifacts (path: id<int>)","DELETE"_method,remove);
+  }
+
+  static crow::json::wvalue stats_sample() {
+    return {{"buckets", 0}, {"artifacts", 0}, {"size", 0}};
+  }
+
+  crow::response tree(const crow::request &req) {
+    auto id = std::atoi(get_param(req, "id").c_str());
+    auto buckets = service.get_subtree(
+        id, app.template get_context<middleware::auth>(req).user_id);
+    if (buckets.empty()) {
+      return crow::response{crow::status::NOT_FOUND};
+    }
+    crow::response res{util::json::page(buckets, std::nullopt)};
+    res.set_header("Content-Type", "application/json");
+    return res;
+  }
+
+  crow::response usage(const crow::request &req) {
+    auto id = std::atoi(get_param(req, "id").c_str());
+    if (auto usage = service.get_usage(
+            id, app.template get_context<middleware::auth>(req).user_id)) {
+      return crow::response{usage->to_json()};
+    }
+    return crow::response{crow::status::NOT_FOUND};
+  }
+
+  crow::response stats(const crow::request &req) {
+    auto id = std::atoi(get_param(req, "id").c_str());
+    if (auto stats = service.get_subtree_stats(
+            id, app.template get_context<middleware::auth>(req).user_id)) {
+      return crow::response{crow::json::wvalue{
+          {"buckets", stats->buckets},
+          {"artifacts", stats->artifacts},
+          {"size", stats->size},
+      }};
+    }
+    return crow::response{crow::status::NOT_FOUND};
+  }
+
+  static crow::json::wvalue list_sample() {
+    auto sample = crow::json::wvalue::list{model::bucket::to_json_sample()};
+    return crow::json::wvalue{{"items", sample}, {"next", "int?"}};
+  }
+
+  crow::response list(const crow::request &req) {
+    auto page = get_page_request(req);
+    auto items = service.list(
+        app.template get_context<middleware::auth>(req).user_id, page.after,
+        page.prefix, page.limit + 1);
+    return page_response(items, page.limit);
   }
 
   crow::response create(const crow::request &req) {
     crow::json::wvalue body = crow::json::load(req.body);
-    body["user_id"] = app.template get_context<Session>(req).get("id", -1);
+    body["user_id"] = app.template get_context<middleware::auth>(req).user_id;
     auto bucket = model::bucket::from_json(crow::json::load(body.dump()));
     auto id = service.insert(bucket);
     return crow::response{bucket.to_json()};
@@ -54,7 +124,7 @@ public:
 
   crow::response read(const crow::request &req) {
     auto id = std::atoi(get_param(req, "id").c_str());
-    if(auto bucket = service.get_with_user(id, app.template get_context<Session>(req).get("id", -1))){
+    if(auto bucket = service.get_with_user(id, app.template get_context<middleware::auth>(req).user_id)){
         return crow::response{bucket.value().to_json()};
     }
     return crow::response{crow::status::NOT_FOUND};
@@ -62,8 +132,10 @@ public:
 
   crow::response remove(const crow::request &req) {
     auto id = std::atoi(get_param(req, "id").c_str());
-    if (auto bucket = service.get_with_user(id,app.template get_context<Session>(req).get("id", -1))){
-        service.remove(bucket.value());
+    if (auto bucket = service.get_with_user(id,app.template get_context<middleware::auth>(req).user_id)){
+        if (!service.remove(bucket.value())) {
+            return crow::response{crow::status::INTERNAL_SERVER_ERROR};
+        }
         return crow::response{crow::status::NO_CONTENT};
     }
     return crow::response{crow::status::NOT_FOUND};
@@ -1,10 +1,15 @@
 #pragma once
+#include "../constants/listing.hpp"
+#include "../util/json.hpp"
+#include "../util/metrics.hpp"
 #include <crow/common.h>
 #include <crow/http_request.h>
 #include <crow/json.h>
 #include <list>
 #include <map>
+#include <optional>
 #include <string>
+#include <vector>
 
 #define EMPTY ""
 
@@ -12,6 +17,9 @@
                                            _description, _method, _handler)    \
   controller::routes[#_controller].push_back(                                  \
       {_name, "/api/" #_controller _route, _description, _method, true});      \
+  util::metrics::registry::instance().add_route(                               \
+      "/api/" #_controller _route, static_cast<int>(_method),                  \
+      crow::method_name(_method));                                             \
   CROW_ROUTE(app, "/api/" #_controller _route)                                 \
       .name(_name)                                                             \
       .CROW_MIDDLEWARES(app, middleware::auth)                                 \
@@ -30,6 +38,9 @@
   controller::routes[#_controller].push_back(                                  \
       {_name, "/api/" #_controller _route, _description, _method, true, _i,    \
        _o});                                                                   \
+  util::metrics::registry::instance().add_route(                               \
+      "/api/" #_controller _route, static_cast<int>(_method),                  \
+      crow::method_name(_method));                                             \
   CROW_ROUTE(app, "/api/" #_controller _route)                                 \
       .name(_name)                                                             \
       .CROW_MIDDLEWARES(app, middleware::auth)                                 \
@@ -43,10 +54,38 @@
         }                                                                      \
       });
 
+/// for handlers taking `(req, res)` that end the response themselves, possibly
+/// later from another thread
+#define controller_register_api_route_auth_io_async(                           \
+    _controller, _name, _route, _description, _method, _handler, _i, _o)       \
+  controller::routes[#_controller].push_back(                                  \
+      {_name, "/api/" #_controller _route, _description, _method, true, _i,    \
+       _o});                                                                   \
+  util::metrics::registry::instance().add_route(                               \
+      "/api/" #_controller _route, static_cast<int>(_method),                  \
+      crow::method_name(_method));                                             \
+  CROW_ROUTE(app, "/api/" #_controller _route)                                 \
+      .name(_name)                                                             \
+      .CROW_MIDDLEWARES(app, middleware::auth)                                 \
+      .methods(_method)([this](const crow::request &req,                       \
+                               crow::response &res) {                          \
+        try {                                                                  \
+          this->_handler(req, res);                                            \
+        } catch (std::runtime_error & e) {                                     \
+          crow::json::wvalue resp;                                             \
+          resp["error"] = e.what();                                            \
+          res = crow::response{crow::status::BAD_REQUEST, resp};               \
+          res.end();                                                           \
+        }                                                                      \
+      });
+
 #define controller_register_api_route(_controller, _name, _route,              \
                                       _description, _method, _handler)         \
   controller::routes[#_controller].push_back(                                  \
       {_name, "/api/" #_controller _route, _description, _method, false});     \
+  util::metrics::registry::instance().add_route(                               \
+      "/api/" #_controller _route, static_cast<int>(_method),                  \
+      crow::method_name(_method));                                             \
   CROW_ROUTE(app, "/api/" #_controller _route)                                 \
       .name(_name)                                                             \
       .methods(_method)([this](const crow::request &req) {                     \
@@ -59,11 +98,35 @@
         }                                                                      \
       });
 
+#define controller_register_api_route_async(_controller, _name, _route,        \
+                                            _description, _method, _handler)   \
+  controller::routes[#_controller].push_back(                                  \
+      {_name, "/api/" #_controller _route, _description, _method, false});     \
+  util::metrics::registry::instance().add_route(                               \
+      "/api/" #_controller _route, static_cast<int>(_method),                  \
+      crow::method_name(_method));                                             \
+  CROW_ROUTE(app, "/api/" #_controller _route)                                 \
+      .name(_name)                                                             \
+      .methods(_method)([this](const crow::request &req,                       \
+                               crow::response &res) {                          \
+        try {                                                                  \
+          this->_handler(req, res);                                            \
+        } catch (std::runtime_error & e) {                                     \
+          crow::json::wvalue resp;                                             \
+          resp["error"] = e.what();                                            \
+          res = crow::response{crow::status::BAD_REQUEST, resp};               \
+          res.end();                                                           \
+        }                                                                      \
+      });
+
 #define controller_register_api_route_io(                                      \
     _controller, _name, _route, _description, _method, _handler, _i, _o)       \
   controller::routes[#_controller].push_back(                                  \
       {_name, "/api/" #_controller _route, _description, _method, false, _i,   \
        _o});                                                                   \
+  util::metrics::registry::instance().add_route(                               \
+      "/api/" #_controller _route, static_cast<int>(_method),                  \
+      crow::method_name(_method));                                             \
   CROW_ROUTE(app, "/api/" #_controller _route)                                 \
       .name(_name)                                                             \
       .methods(_method)([this](const crow::request &req) {                     \
@@ -118,5 +181,42 @@ public:
     }
     return default_value;
   }
+
+  /// cursor, name filter and size of a list endpoint page
+  struct page_request {
+    int after;
+    std::string prefix;
+    int limit;
+  };
+
+  static inline page_request get_page_request(const crow::request &request) {
+    auto limit = std::atoi(
+        get_param_or(request, "limit",
+                     std::to_string(constants::listing::page_size))
+            .c_str());
+    if (limit < 1 || limit > constants::listing::max_page_size) {
+      throw std::runtime_error(
+          "limit must be between 1 and " +
+          std::to_string(constants::listing::max_page_size));
+    }
+    return page_request{
+        .after = std::atoi(get_param_or(request, "after", "0").c_str()),
+        .prefix = get_param_or(request, "prefix", ""),
+        .limit = limit};
+  }
+
+  /// `items` holds one row more than `limit` when there is a next page
+  template <typename T>
+  static inline crow::response page_response(std::vector<T> &items,
+                                             int limit) {
+    std::optional<int> next;
+    if (items.size() > static_cast<std::size_t>(limit)) {
+      items.resize(limit);
+      next = items.back().id;
+    }
+    crow::response res{util::json::page(items, next)};
+    res.set_header("Content-Type", "application/json");
+    return res;
+  }
 };
 } // namespace controller
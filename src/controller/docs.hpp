@@ -8,11 +8,15 @@
 #include <optional>
 #include <stdexcept>
 #include "../middleware/auth.hpp"
+#include "../middleware/compression.hpp"
 #include "controller.internal.hpp"
 namespace controller {
-  using Session = crow::SessionMiddleware<crow::FileStore>;
+  using Session = middleware::Session;
+/// Route listing, rendered once by `publish` after every controller has
+/// registered and served with an ETag from then on
 template <typename... M> class docs {
   crow::Crow<M...> &app;
+  std::optional<middleware::precompressed> rendered;
 
 public:
   docs(crow::Crow<M...> &app)
@@ -20,7 +24,7 @@ public:
     controller_register_api_route(docs, "routes", "", "Docs", "GET"_method, get_docs);
  }
 
-  crow::response get_docs(const crow::request &req){
+  static crow::json::wvalue render() {
     crow::json::wvalue resp;
     for(const auto & [name, routes] : controller::controller::routes){
       auto routes_vect = std::vector<crow::json::wvalue>{};
@@ -29,7 +33,17 @@ public:
       }
       resp[name] = std::move(routes_vect);
     }
-    return crow::response{resp};
+    return resp;
+  }
+
+  /// routes never change once the server runs, call before `app.run()`
+  void publish() { rendered.emplace(render().dump(), "application/json"); }
+
+  crow::response get_docs(const crow::request &req){
+    if (!rendered) {
+      return crow::response{render()};
+    }
+    return rendered->serve(req);
   }
 };
 } // namespace controller
@@ -12,7 +12,6 @@
 #include <stdexcept>
 
 namespace controller {
-using Session = crow::SessionMiddleware<crow::FileStore>;
 template <typename S, typename... M> class user : public controller {
   crow::Crow<M...> &app;
   service::user<S> &service;
@@ -26,6 +25,11 @@ public:
                                   crow::HTTPMethod::Post, create, model::user::from_json_sample(), model::user::to_json_sample());
     controller_register_api_route_auth_io(user, "update", EMPTY, "Update current user",
                                   "PUT"_method, update, model::user::from_json_sample(), model::user::to_json_sample());
+    controller_register_api_route_auth_io(
+        user, "usage", "/usage",
+        "Artifact count, content bytes and last write over all buckets of "
+        "the current user",
+        "GET"_method, usage, {}, model::user_usage::to_json_sample());
     controller_register_api_route_auth(user, "delete", EMPTY, "Delete current user", "DELETE"_method,remove);
   }
 
@@ -37,7 +41,7 @@ public:
   }
 
   crow::response update(const crow::request &req){
-    if (auto user = service.get(app.template get_context<Session>(req).get("id", -1))){
+    if (auto user = service.get(app.template get_context<middleware::auth>(req).user_id)){
         auto new_user = model::user::from_json(crow::json::load(req.body));
         new_user.id = user.value().id;
         new_user.created_at = user.value().created_at;
@@ -48,15 +52,24 @@ public:
   }
 
   crow::response read(const crow::request &req) {
-    if (auto user = service.get(app.template get_context<Session>(req).get("id", -1))){
+    if (auto user = service.get(app.template get_context<middleware::auth>(req).user_id)){
         return crow::response{user.value().to_json()};
     }
     return crow::response{crow::status::NOT_FOUND};
   }
 
+  crow::response usage(const crow::request &req) {
+    return crow::response{
+        service
+            .get_usage(app.template get_context<middleware::auth>(req).user_id)
+            .to_json()};
+  }
+
   crow::response remove(const crow::request &req) {
-    if (auto user = service.get(app.template get_context<Session>(req).get("id", -1))){
-        service.remove(user.value());
+    if (auto user = service.get(app.template get_context<middleware::auth>(req).user_id)){
+        if (!service.remove(user.value())) {
+            return crow::response{crow::status::INTERNAL_SERVER_ERROR};
+        }
         return crow::response{crow::status::NO_CONTENT};
     }
     return crow::response{crow::status::NOT_FOUND};
@@ -1,9 +1,13 @@
 #pragma once
+#include <algorithm>
+#include <array>
+#include <cstddef>
 #include <functional>
 #include <map>
 #include <optional>
 #include <stdexcept>
 #include <string>
+#include <string_view>
 #include <type_traits>
 #include <utility>
 namespace hyper {
@@ -31,26 +35,19 @@ struct const_string {
 
 class block_tag {
   std::string &content;
-  const std::string tag;
+  const std::string_view tag;
 
 public:
-  block_tag(const std::string &tag, std::string &content,
-            const std::string &inject = "",
-            const std::map<std::string, std::string> &params = {})
-      : tag(std::move(tag)), content(content) {
+  constexpr block_tag(std::string_view tag, std::string &content,
+                      std::string_view attributes = "")
+      : content(content), tag(tag) {
     content += "<";
     content += tag;
-    for (auto &[key, value] : params) {
-      content += " ";
-      content += key;
-      content += "=\"";
-      content += value;
-      content += "\"";
-    }
-    content += (inject.empty() ? "" : " " + inject) + ">";
+    content += attributes;
+    content += ">";
   }
 
-  ~block_tag() {
+  constexpr ~block_tag() {
     content += "</";
     content += tag;
     content += ">";
@@ -58,24 +55,13 @@ public:
 };
 
 class inline_tag {
-  std::string &content;
-  const std::string tag;
-
 public:
-  inline_tag(const std::string &tag, std::string &content,
-             const std::string &inject = "",
-             const std::map<std::string, std::string> &params = {})
-      : tag(std::move(tag)), content(content) {
+  constexpr inline_tag(std::string_view tag, std::string &content,
+                       std::string_view attributes = "") {
     content += "<";
     content += tag;
-    for (auto &[key, value] : params) {
-      content += " ";
-      content += key;
-      content += "=\"";
-      content += value;
-      content += "\"";
-    }
-    content += (inject.empty() ? "" : " " + inject) + ">";
+    content += attributes;
+    content += ">";
   }
 };
 
@@ -100,38 +86,130 @@ public:
   }
 };
 
+namespace detail {
+/// a `<<name>>` field marker in a skeleton, `name` indexes the skeleton
+struct placeholder {
+  std::size_t begin;
+  std::size_t end;
+  std::size_t name;
+  std::size_t name_size;
+};
+
+constexpr bool is_field_char(char c) {
+  return (c >= 'a' && c <= 'z') || (c >= 'A' && c <= 'Z') ||
+         (c >= '0' && c <= '9') || c == '_' || c == '-';
+}
+
+/// calls `visit` with every field marker of `markup`, in order
+template <typename Visitor>
+constexpr void scan(std::string_view markup, Visitor visit) {
+  auto pos = markup.find("<<");
+  while (pos != std::string_view::npos) {
+    auto end = pos + 2;
+    while (end < markup.size() && is_field_char(markup[end])) {
+      end++;
+    }
+    if (end > pos + 2 && markup.substr(end, 2) == ">>") {
+      visit(placeholder{pos, end + 2, pos + 2, end - pos - 2});
+      pos = markup.find("<<", end + 2);
+    } else {
+      pos = markup.find("<<", pos + 1);
+    }
+  }
+}
+
+/// The static markup of `Element` (its `skeleton()`), built and scanned
+/// for field markers at compile time. Rendering resolves each marker once
+/// and copies skeleton and values into a single allocation. Every marker of
+/// a field is replaced, markers of missing fields are left as they are.
+template <typename Element> struct skeleton {
+  static constexpr std::size_t size = Element::skeleton().size();
+
+  static constexpr std::size_t count = [] {
+    std::size_t result = 0;
+    scan(Element::skeleton(), [&result](placeholder) { result++; });
+    return result;
+  }();
+
+  static constexpr std::array<char, size> markup = [] {
+    std::array<char, size> result{};
+    auto built = Element::skeleton();
+    std::copy(built.begin(), built.end(), result.begin());
+    return result;
+  }();
+
+  static constexpr std::array<placeholder, count> placeholders = [] {
+    std::array<placeholder, count> result{};
+    std::size_t i = 0;
+    scan(Element::skeleton(),
+         [&result, &i](placeholder found) { result[i++] = found; });
+    return result;
+  }();
+
+  static std::string
+  render(const std::map<std::string, std::string> &fields) {
+    const std::string_view view(markup.data(), size);
+    std::array<const std::string *, count> values{};
+    auto total = size;
+    for (std::size_t i = 0; i < count; i++) {
+      const auto &marker = placeholders[i];
+      auto found = fields.find(
+          std::string(view.substr(marker.name, marker.name_size)));
+      if (found != fields.end()) {
+        values[i] = &found->second;
+        total += found->second.size() - (marker.end - marker.begin);
+      }
+    }
+    std::string result;
+    result.reserve(total);
+    std::size_t copied = 0;
+    for (std::size_t i = 0; i < count; i++) {
+      if (values[i]) {
+        result.append(view.substr(copied, placeholders[i].begin - copied));
+        result.append(*values[i]);
+        copied = placeholders[i].end;
+      }
+    }
+    result.append(view.substr(copied));
+    return result;
+  }
+};
+} // namespace detail
+
 template <typename head = void, typename body = void>
 class html : public exportable_html_element {
 public:
-  explicit html(const std::map<std::string, std::string> &fields = {}) {
-    block_tag it("html", content);
-    if constexpr (!std::is_same_v<head, void>) {
-      head{content};
-    }
+  static constexpr std::string skeleton() {
+    std::string content;
+    {
+      block_tag it("html", content);
+      if constexpr (!std::is_same_v<head, void>) {
+        head{content};
+      }
 
-    if constexpr (!std::is_same_v<body, void>) {
-      body{content};
+      if constexpr (!std::is_same_v<body, void>) {
+        body{content};
+      }
     }
+    return content;
+  }
 
-    for (const auto &[k, v] : fields) {
-      const auto pos = content.find("<<" + k + ">>");
-      if (pos != std::string::npos)
-        content.replace(pos, k.length() + 4, v);
-    }
+  explicit html(const std::map<std::string, std::string> &fields = {}) {
+    content = detail::skeleton<html>::render(fields);
   }
 };
 
 template <typename... children> class part : public exportable_html_element {
 public:
-  part(const std::map<std::string, std::string> &fields = {}) {
+  static constexpr std::string skeleton() {
     RESTRICT_TAGS(children, body_element);
+    std::string content;
     (children(content), ...);
+    return content;
+  }
 
-    for (const auto &[k, v] : fields) {
-      const auto pos = content.find("<<" + k + ">>");
-      if (pos != std::string::npos)
-        content.replace(pos, k.length() + 4, v);
-    }
+  part(const std::map<std::string, std::string> &fields = {}) {
+    content = detail::skeleton<part>::render(fields);
   }
 };
 
@@ -139,7 +217,7 @@ public:
 template <typename... children> class head : head_element {
 public:
   std::string &content;
-  head(std::string &content) : content(content) {
+  constexpr head(std::string &content) : content(content) {
     block_tag it("head", content);
     // RESTRICT_TAGS(children, head_element);
     (children(content), ...);
@@ -153,24 +231,22 @@ static constexpr const char *meta_type_strs[] = {
 ///! Meta Info: Defines metadata about an HTML document
 template <meta_type type, const_string value = "None">
 class meta : head_element {
-
-  std::map<std::string, std::string> pairs;
-
 public:
   std::string &content;
-  std::string value_str = value.c_str();
-  meta(std::string &content) : content(content) {
-    auto k = meta_type_strs[type];
-    auto v = value_str;
-    pairs[k] = v;
-    inline_tag it("meta", content, "", pairs);
+  constexpr meta(std::string &content) : content(content) {
+    std::string attribute = " ";
+    attribute += meta_type_strs[type];
+    attribute += "=\"";
+    attribute += value.c_str();
+    attribute += "\"";
+    inline_tag it("meta", content, attribute);
   }
 };
 
 template <typename... children> class body : body_element {
 public:
   std::string &content;
-  body(std::string &content) : content(content) {
+  constexpr body(std::string &content) : content(content) {
     block_tag it("body", content);
     RESTRICT_TAGS(children, body_element);
     (children(content), ...);
@@ -182,7 +258,7 @@ public:
 template <typename... children> class template$ : body_element {
 public:
   std::string &content;
-  template$(std::string &content) : content(content) {
+  constexpr template$(std::string &content) : content(content) {
     block_tag it("template", content);
     RESTRICT_TAGS(children, body_element);
     (children(content), ...);
@@ -193,7 +269,7 @@ public:
   template <typename... children> class NAME : body_element {                  \
   public:                                                                      \
     std::string &content;                                                      \
-    NAME(std::string &content) : content(content) {                            \
+    constexpr NAME(std::string &content) : content(content) {                  \
       inline_tag it(#NAME, content);                                           \
       (children(content), ...);                                                \
     }                                                                          \
@@ -203,7 +279,7 @@ public:
 template <typename... children> class comment : body_element {
 public:
   std::string &content;
-  comment(std::string &content) : content(content) {
+  constexpr comment(std::string &content) : content(content) {
     content += "<!--";
     (children(content), ...);
     content += "--!>";
@@ -214,7 +290,7 @@ public:
   template <typename... children> class NAME : body_element {                  \
   public:                                                                      \
     std::string &content;                                                      \
-    NAME(std::string &content) : content(content) {                            \
+    constexpr NAME(std::string &content) : content(content) {                  \
       block_tag it(#NAME, content);                                            \
       (children(content), ...);                                                \
     }                                                                          \
@@ -224,7 +300,7 @@ public:
   template <typename... children> class NAME : body_element {                  \
   public:                                                                      \
     std::string &content;                                                      \
-    NAME(std::string &content) : content(content) {                            \
+    constexpr NAME(std::string &content) : content(content) {                  \
       block_tag it(EXPR, content);                                             \
       (children(content), ...);                                                \
     }                                                                          \
@@ -486,8 +562,7 @@ CREATE_BODY_BLOCK_COMPONENT(data);
   template <const_string value = "None"> class $##NAME : body_element {        \
   public:                                                                      \
     std::string &content;                                                      \
-    std::map<std::string, std::string> pairs;                                  \
-    $##NAME(std::string &content) : content(content) {                         \
+    constexpr $##NAME(std::string &content) : content(content) {               \
       content.insert(content.rfind(">"),                                       \
                      std::string(" " #NAME "=\"") + value.c_str() + "\"");     \
     }                                                                          \
@@ -498,8 +573,7 @@ CREATE_BODY_BLOCK_COMPONENT(data);
 template <const_string value = "None"> class $accept_charset : body_element {
 public:
   std::string &content;
-  std::map<std::string, std::string> pairs;
-  $accept_charset(std::string &content) : content(content) {
+  constexpr $accept_charset(std::string &content) : content(content) {
     content.insert(content.rfind(">"),
                    std::string(" accept-charset=\"") + value.c_str() + "\"");
   }
@@ -511,8 +585,7 @@ template <const_string key = "None", const_string value = "None">
 class $data_ : body_element {
 public:
   std::string &content;
-  std::map<std::string, std::string> pairs;
-  $data_(std::string &content) : content(content) {
+  constexpr $data_(std::string &content) : content(content) {
     content.insert(content.rfind(">"),
                    " " + std::string(key) + "=\"" + value.c_str() + "\"");
   }
@@ -984,13 +1057,15 @@ CREATE_BODY_BLOCK_COMPONENT(param);
 template <const_string _text> class text : body_element {
 public:
   std::string &content;
-  text(std::string &content) : content(content) { content += _text.c_str(); }
+  constexpr text(std::string &content) : content(content) {
+    content += _text.c_str();
+  }
 };
 
 template <const_string _text> class $ : body_element {
 public:
   std::string &content;
-  $(std::string &content) : content(content) {
+  constexpr $(std::string &content) : content(content) {
     content += "<<";
     content += _text.c_str();
     content += ">>";
@@ -1940,8 +2015,7 @@ constexpr auto htmx_2_0_1_str =
 template <const_string value = "None"> class $on : body_element {
 public:
   std::string &content;
-  std::map<std::string, std::string> pairs;
-  $on(std::string &content) : content(content) {
+  constexpr $on(std::string &content) : content(content) {
     content.insert(content.rfind(">"), std::string(" hx-on-" + value + "=\"") +
                                            value.c_str() + "\"");
   }
@@ -1951,8 +2025,7 @@ public:
   template <const_string value = "None"> class $##NAME : body_element {        \
   public:                                                                      \
     std::string &content;                                                      \
-    std::map<std::string, std::string> pairs;                                  \
-    $##NAME(std::string &content) : content(content) {                         \
+    constexpr $##NAME(std::string &content) : content(content) {               \
       content.insert(content.rfind(">"), std::string(" ") + ATTRIBUTE +        \
                                              " =\"" + value.c_str() + "\"");   \
     }                                                                          \
@@ -1,22 +1,115 @@
 #pragma once
+#include "../constants/auth.hpp"
+#include "../util/env.hpp"
+#include "../util/token.hpp"
 #include "crow/app.h"
 #include "crow/http_request.h"
 #include "crow/http_response.h"
 #include "crow/logging.h"
 #include "crow/middleware.h"
-#include <crow/middlewares/session.h>
+#include "session.hpp"
+#include <chrono>
 #include <functional>
+#include <random>
+#include <stdexcept>
+#include <string>
+#include <vector>
 namespace middleware {
-using Session = crow::SessionMiddleware<crow::FileStore>;
 
+struct auth_options {
+  bool sessions = true;
+  bool tokens = false;
+  int token_lifetime = constants::auth::token_lifetime;
+  /// HMAC key of the bearer tokens and presigned urls
+  std::string secret;
+
+  static auth_options from_env() {
+    auto mode =
+        util::env::get_or<std::string>("XBUCKET_AUTH_MODE", constants::auth::mode);
+    if (mode != "session" && mode != "token" && mode != "both") {
+      throw std::runtime_error("invalid auth mode: " + mode);
+    }
+    auth_options options{
+        .sessions = mode != "token",
+        .tokens = mode != "session",
+        .token_lifetime = util::env::get_or("XBUCKET_TOKEN_LIFETIME",
+                                            constants::auth::token_lifetime),
+        .secret = util::env::get_or<std::string>("XBUCKET_SECRET", ""),
+    };
+    if (options.secret.empty()) {
+      CROW_LOG_WARNING << "XBUCKET_SECRET is not set, tokens and presigned "
+                          "urls will not survive a restart";
+      std::random_device random;
+      for (int i = 0; i < 32; i++) {
+        options.secret += static_cast<char>(random());
+      }
+    }
+    return options;
+  }
+};
+
+/// Authenticates a request either with `Authorization: Bearer <token>`,
+/// checked against its signature alone, or with the session cookie. The
+/// user is then available to handlers as `get_context<auth>(req).user_id`.
 struct auth : crow::ILocalMiddleware {
-  struct context {};
+  struct context {
+    int user_id = -1;
+    std::vector<std::string> scopes;
+  };
+
+  /// sessions only and no secret until `configure` runs
+  auth_options options;
+
+  /// reads the options from the environment, called from server::run() so
+  /// a bad XBUCKET_AUTH_MODE is reported instead of failing static init
+  void configure() { options = auth_options::from_env(); }
+
+  static std::int64_t now() {
+    return std::chrono::duration_cast<std::chrono::seconds>(
+               std::chrono::system_clock::now().time_since_epoch())
+        .count();
+  }
+
+  util::token::claims issue(int user_id,
+                            std::vector<std::string> scopes) const {
+    return {user_id, now() + options.token_lifetime, std::move(scopes)};
+  }
+
+  std::string sign(const util::token::claims &claims) const {
+    return util::token::issue(claims, options.secret);
+  }
 
   template <typename AllContext>
-  void before_handle(crow::request &req, crow::response &res, context &,
+  void before_handle(crow::request &req, crow::response &res, context &context,
                      AllContext &ctx) {
-    auto &context = ctx.template get<Session>();
-    if (context.get("id", -1) == -1) {
+    const auto &authorization = req.get_header_value("Authorization");
+    if (options.tokens && authorization.starts_with("Bearer ")) {
+      auto claims = util::token::verify(
+          std::string_view(authorization).substr(7), options.secret, now());
+      // safe methods need the read scope, everything else write
+      auto scope = req.method == crow::HTTPMethod::Get ||
+                           req.method == crow::HTTPMethod::Head
+                       ? "read"
+                       : "write";
+      if (!claims) {
+        res.code = crow::status::UNAUTHORIZED;
+        res.set_header("WWW-Authenticate", "Bearer error=\"invalid_token\"");
+        res.end();
+      } else if (!claims->has_scope(scope)) {
+        res.code = crow::status::FORBIDDEN;
+        res.set_header("WWW-Authenticate",
+                       "Bearer error=\"insufficient_scope\"");
+        res.end();
+      } else {
+        context.user_id = claims->user_id;
+        context.scopes = std::move(claims->scopes);
+      }
+      return;
+    }
+    if (options.sessions) {
+      context.user_id = ctx.template get<Session>().get("id", -1);
+    }
+    if (context.user_id == -1) {
       res.code = crow::status::FORBIDDEN;
       res.end();
     }
@@ -0,0 +1,117 @@
+#pragma once
+#include "../constants/compression.hpp"
+#include "../util/compression.hpp"
+#include "../util/env.hpp"
+#include "../util/http.hpp"
+#include "../util/sha256.hpp"
+#include "crow/http_request.h"
+#include "crow/http_response.h"
+#include "crow/logging.h"
+#include <array>
+#include <cstddef>
+#include <string>
+
+namespace middleware {
+/// strong validators differ per coding (RFC 9110 8.8.3)
+inline std::string encoded_etag(std::string etag,
+                                util::compression::encoding encoding) {
+  if (encoding != util::compression::encoding::identity && etag.size() > 1 &&
+      etag.back() == '"') {
+    etag.insert(etag.size() - 1, std::string("-") +
+                                     util::compression::name(encoding));
+  }
+  return etag;
+}
+
+/// Compresses text responses above `threshold` bytes with the best coding
+/// the client accepts. Responses already encoded, partial, streamed from
+/// disk or of binary types are left alone.
+struct compression {
+  struct context {};
+
+  std::size_t threshold = constants::compression::threshold;
+
+  /// reads XBUCKET_COMPRESSION_THRESHOLD, called from server::run()
+  void configure() {
+    threshold = util::env::get_or("XBUCKET_COMPRESSION_THRESHOLD",
+                                  constants::compression::threshold);
+  }
+
+  void before_handle(crow::request &req, crow::response &res, context &ctx) {}
+
+  void after_handle(crow::request &req, crow::response &res, context &ctx) {
+    if (res.code != crow::status::OK || res.body.size() < threshold ||
+        res.is_static_type() ||
+        !res.get_header_value("Content-Encoding").empty()) {
+      return;
+    }
+    // crow defaults a missing type to text/html
+    const auto &content_type = res.get_header_value("Content-Type");
+    if (!content_type.empty() &&
+        !util::compression::is_compressible(content_type)) {
+      return;
+    }
+    res.set_header("Vary", "Accept-Encoding");
+    auto encoding = util::compression::negotiate(
+        req.get_header_value("Accept-Encoding"));
+    if (encoding == util::compression::encoding::identity) {
+      return;
+    }
+    try {
+      res.body = util::compression::compress(
+          res.body, encoding, util::compression::effort::fast);
+    } catch (std::runtime_error &e) {
+      CROW_LOG_ERROR << e.what();
+      return;
+    }
+    res.set_header("Content-Encoding", util::compression::name(encoding));
+    const auto &etag = res.get_header_value("ETag");
+    if (!etag.empty()) {
+      res.set_header("ETag", encoded_etag(etag, encoding));
+    }
+  }
+};
+
+/// Static content compressed once, at the highest effort, in every coding
+/// we support. Serving picks the variant the client accepts and copies it.
+class precompressed {
+  std::string content_type;
+  std::string etag;
+  std::array<std::string, 4> variants;
+
+public:
+  precompressed(const std::string &body, std::string content_type)
+      : content_type(std::move(content_type)),
+        etag("\"" + util::sha256::hex_digest(body).substr(0, 32) + "\"") {
+    using util::compression::encoding;
+    for (auto coding : {encoding::zstd, encoding::br, encoding::gzip}) {
+      if (util::compression::available(coding)) {
+        variants[static_cast<int>(coding)] = util::compression::compress(
+            body, coding, util::compression::effort::best);
+      }
+    }
+    variants[static_cast<int>(encoding::identity)] = body;
+  }
+
+  crow::response serve(const crow::request &req) const {
+    auto encoding = util::compression::negotiate(
+        req.get_header_value("Accept-Encoding"));
+    auto tag = encoded_etag(etag, encoding);
+    crow::response res;
+    res.set_header("ETag", tag);
+    res.set_header("Vary", "Accept-Encoding");
+    res.set_header("Cache-Control", "no-cache");
+    if (util::http::etag_list_matches(req.get_header_value("If-None-Match"),
+                                      tag)) {
+      res.code = crow::status::NOT_MODIFIED;
+      return res;
+    }
+    res.set_header("Content-Type", content_type);
+    if (encoding != util::compression::encoding::identity) {
+      res.set_header("Content-Encoding", util::compression::name(encoding));
+    }
+    res.body = variants[static_cast<int>(encoding)];
+    return res;
+  }
+};
+} // namespace middleware
@@ -0,0 +1,35 @@
+#pragma once
+#include "../util/metrics.hpp"
+#include "crow/http_request.h"
+#include "crow/http_response.h"
+#include <chrono>
+
+namespace middleware {
+/// Times every request to a registered route, from routing until its
+/// response ends, which for asynchronous handlers is when they call end()
+struct metrics {
+  struct context {
+    std::chrono::steady_clock::time_point started;
+  };
+
+  void before_handle(crow::request &req, crow::response &res, context &ctx) {
+    ctx.started = std::chrono::steady_clock::now();
+  }
+
+  void after_handle(crow::request &req, crow::response &res, context &ctx) {
+    auto *route = util::metrics::registry::instance().find_route(
+        req.url, static_cast<int>(req.method));
+    if (route == nullptr) {
+      return;
+    }
+    route->latency.record(
+        std::chrono::duration_cast<std::chrono::microseconds>(
+            std::chrono::steady_clock::now() - ctx.started)
+            .count());
+    auto status_class = res.code / 100;
+    if (status_class >= 1 && status_class <= 5) {
+      route->responses[status_class - 1].add();
+    }
+  }
+};
+} // namespace middleware
@@ -0,0 +1,259 @@
+#pragma once
+#include "../constants/filesystem.hpp"
+#include "../constants/session.hpp"
+#include "../util/env.hpp"
+#include "crow/json.h"
+#include "crow/logging.h"
+#include <algorithm>
+#include <array>
+#include <chrono>
+#include <condition_variable>
+#include <cstdint>
+#include <filesystem>
+#include <fstream>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <sstream>
+#include <string>
+#include <thread>
+#include <unordered_map>
+#include <crow/middlewares/session.h>
+
+namespace middleware {
+/// Session store for crow::SessionMiddleware that keeps sessions in memory,
+/// split into independently locked shards. Sessions expire `lifetime`
+/// seconds after their last request; when snapshots are enabled the store is
+/// written to `xdir/sessions/` periodically and on shutdown, and read back
+/// on startup.
+class session_store {
+  using values =
+      std::unordered_map<std::string, crow::session::multi_value>;
+
+  struct session {
+    values entries;
+    std::int64_t expires;
+  };
+
+  struct shard {
+    std::mutex mutex;
+    std::unordered_map<std::string, session> sessions;
+  };
+
+  /// shared so the store stays copyable, the middleware takes it by value
+  struct state {
+    std::array<shard, constants::session::shards> shards;
+    int lifetime;
+    int snapshot_interval;
+    std::filesystem::path snapshot_path;
+
+    std::mutex mutex;
+    std::condition_variable stopping;
+    bool stopped = false;
+    std::thread worker;
+
+    ~state() {
+      if (!worker.joinable()) {
+        return;
+      }
+      {
+        std::lock_guard lock(mutex);
+        stopped = true;
+      }
+      stopping.notify_all();
+      worker.join();
+      if (snapshot_interval > 0) {
+        snapshot();
+      }
+    }
+
+    static std::int64_t now() {
+      return std::chrono::duration_cast<std::chrono::seconds>(
+                 std::chrono::system_clock::now().time_since_epoch())
+          .count();
+    }
+
+    shard &get_shard(const std::string &id) {
+      return shards[std::hash<std::string>{}(id) % shards.size()];
+    }
+
+    void sweep() {
+      auto current = now();
+      for (auto &shard : shards) {
+        std::lock_guard lock(shard.mutex);
+        std::erase_if(shard.sessions, [current](const auto &item) {
+          return item.second.expires <= current;
+        });
+      }
+    }
+
+    void snapshot() {
+      crow::json::wvalue root(crow::json::type::Object);
+      for (auto &shard : shards) {
+        std::lock_guard lock(shard.mutex);
+        for (const auto &[id, session] : shard.sessions) {
+          auto &item = root[id];
+          item["expires"] = session.expires;
+          item["entries"] = crow::json::wvalue(crow::json::type::Object);
+          for (const auto &[key, value] : session.entries) {
+            item["entries"][key] = value.json();
+          }
+        }
+      }
+      auto temporary = snapshot_path;
+      temporary += ".tmp";
+      {
+        std::ofstream file(temporary, std::ios::trunc);
+        file << root.dump();
+        if (!file) {
+          CROW_LOG_ERROR << "failed to write session snapshot " << temporary;
+          return;
+        }
+      }
+      std::error_code error;
+      std::filesystem::rename(temporary, snapshot_path, error);
+      if (error) {
+        CROW_LOG_ERROR << "failed to write session snapshot: "
+                       << error.message();
+      }
+    }
+
+    void restore() {
+      std::ifstream file(snapshot_path);
+      if (!file) {
+        return;
+      }
+      std::stringstream buffer;
+      buffer << file.rdbuf();
+      auto root = crow::json::load(buffer.str());
+      if (!root || root.t() != crow::json::type::Object) {
+        CROW_LOG_WARNING << "ignoring invalid session snapshot "
+                         << snapshot_path;
+        return;
+      }
+      auto current = now();
+      for (const auto &item : root) {
+        if (!item.has("expires") || !item.has("entries") ||
+            item["expires"].i() <= current) {
+          continue;
+        }
+        session restored{{}, item["expires"].i()};
+        for (const auto &value : item["entries"]) {
+          restored.entries[value.key()] =
+              crow::session::multi_value::from_json(value);
+        }
+        get_shard(item.key()).sessions[item.key()] = std::move(restored);
+      }
+    }
+
+    void run() {
+      using namespace std::chrono;
+      auto interval =
+          snapshot_interval > 0
+              ? std::min(snapshot_interval, constants::session::sweep_interval)
+              : constants::session::sweep_interval;
+      auto last_snapshot = steady_clock::now();
+      std::unique_lock lock(mutex);
+      while (!stopping.wait_for(lock, seconds(interval),
+                                [this] { return stopped; })) {
+        lock.unlock();
+        sweep();
+        if (snapshot_interval > 0 &&
+            steady_clock::now() - last_snapshot >=
+                seconds(snapshot_interval)) {
+          snapshot();
+          last_snapshot = steady_clock::now();
+        }
+        lock.lock();
+      }
+    }
+  };
+
+  std::shared_ptr<state> store;
+
+public:
+  /// The app holding the store is built during static initialisation, so
+  /// nothing happens until `start`: before it sessions live in memory only
+  session_store() : store(std::make_shared<state>()) {
+    store->lifetime = constants::session::lifetime;
+    store->snapshot_interval = 0;
+  }
+
+  /// reads the configuration, restores the snapshot and starts sweeping,
+  /// once the directories exist
+  void start() {
+    start(util::env::get_or("XBUCKET_SESSION_LIFETIME",
+                            constants::session::lifetime),
+          util::env::get_or("XBUCKET_SESSION_SNAPSHOT_INTERVAL",
+                            constants::session::snapshot_interval));
+  }
+
+  void start(int lifetime, int snapshot_interval) {
+    if (store->worker.joinable()) {
+      return;
+    }
+    store->lifetime = lifetime;
+    store->snapshot_interval = snapshot_interval;
+    store->snapshot_path =
+        std::filesystem::path(constants::filesystem::xbucket_sessions_dir) /
+        constants::session::snapshot_name;
+    if (snapshot_interval > 0) {
+      store->restore();
+    }
+    store->worker = std::thread([self = store.get()] { self->run(); });
+  }
+
+  /// copies the session into the middleware's cache and extends its lifetime
+  void load(crow::session::CachedSession &cached) {
+    auto &shard = store->get_shard(cached.session_id);
+    std::lock_guard lock(shard.mutex);
+    auto found = shard.sessions.find(cached.session_id);
+    if (found == shard.sessions.end()) {
+      return;
+    }
+    found->second.expires = state::now() + store->lifetime;
+    cached.entries = found->second.entries;
+  }
+
+  void save(crow::session::CachedSession &cached) {
+    auto &shard = store->get_shard(cached.session_id);
+    std::lock_guard lock(shard.mutex);
+    shard.sessions[cached.session_id] = {cached.entries,
+                                         state::now() + store->lifetime};
+  }
+
+  bool contains(const std::string &id) {
+    auto &shard = store->get_shard(id);
+    std::lock_guard lock(shard.mutex);
+    auto found = shard.sessions.find(id);
+    if (found == shard.sessions.end()) {
+      return false;
+    }
+    if (found->second.expires <= state::now()) {
+      shard.sessions.erase(found);
+      return false;
+    }
+    return true;
+  }
+
+  void remove(const std::string &id) {
+    auto &shard = store->get_shard(id);
+    std::lock_guard lock(shard.mutex);
+    shard.sessions.erase(id);
+  }
+
+  int get_lifetime() { return store->lifetime; }
+
+  /// sessions held, expired ones included until the next sweep
+  std::size_t size() {
+    std::size_t result = 0;
+    for (auto &shard : store->shards) {
+      std::lock_guard lock(shard.mutex);
+      result += shard.sessions.size();
+    }
+    return result;
+  }
+};
+
+using Session = crow::SessionMiddleware<session_store>;
+} // namespace middleware
@@ -13,6 +13,8 @@ struct artifact {
   std::string original_filename;
   decltype(model::bucket::id) bucket_id;
   std::optional<decltype(model::artifact::id)> super;
+  std::string sha256;
+  std::string crc32c;
   std::string created_at;
   std::string updated_at;
 
@@ -24,6 +26,8 @@ struct artifact {
         {"filename", filename},
         {"original_filename", original_filename},
         {"bucket_id", bucket_id},
+        {"sha256", sha256},
+        {"crc32c", crc32c},
         {"created_at", created_at},
         {"updated_at", updated_at},
     };
@@ -60,6 +64,8 @@ static inline model::artifact from_json(const crow::json::rvalue &json) {
         make_column("original_filename", &artifact::original_filename),
         make_column("bucket_id", &artifact::bucket_id),
         make_column("super", &artifact::super),
+        make_column("sha256", &artifact::sha256, default_value("")),
+        make_column("crc32c", &artifact::crc32c, default_value("")),
         make_column("created_at", &artifact::created_at),
         make_column("updated_at", &artifact::updated_at),
         foreign_key(&artifact::bucket_id).references(&model::bucket::id)
@@ -0,0 +1,33 @@
+#pragma once
+#include <crow/json.h>
+#include <cstdint>
+#include <sqlite_orm/sqlite_orm.h>
+#include <string>
+
+namespace model {
+/// Content addressed file under xbucket_uploads_dir, shared by every
+/// artifact whose `filename` is `hash`.
+struct blob {
+  std::string hash;
+  std::int64_t size;
+  int refs;
+  std::string created_at;
+
+  inline crow::json::wvalue to_json() const {
+    return {
+        {"hash", hash},
+        {"size", size},
+        {"refs", refs},
+        {"created_at", created_at},
+    };
+  }
+
+  static inline auto make_table() {
+    using namespace sqlite_orm;
+    return sqlite_orm::make_table(
+        "blob", make_column("hash", &blob::hash, primary_key()),
+        make_column("size", &blob::size), make_column("refs", &blob::refs),
+        make_column("created_at", &blob::created_at));
+  }
+};
+} // namespace model
@@ -1,9 +1,12 @@
 #pragma once
+#include "../constants/image.hpp"
 #include "../util/json.hpp"
 #include "user.hpp"
 #include <crow/json.h>
 #include <sqlite_orm/sqlite_orm.h>
+#include <stdexcept>
 #include <string>
+#include <string_view>
 
 namespace model {
 struct bucket {
@@ -12,6 +15,14 @@ struct bucket {
   std::string description;
   decltype(model::user::id) user_id;
   std::optional<decltype(model::bucket::id)> super;
+  /// comma separated renditions generated for uploaded images, empty for
+  /// buckets that don't hold images
+  std::string renditions;
+  /// recompression applied to uploaded images, empty stores them as sent
+  std::string compression;
+  int compression_quality = constants::image::default_compression_quality;
+  /// keep the upload as sent as a child of the recompressed artifact
+  bool keep_original = false;
   std::string created_at;
   std::string updated_at;
 
@@ -22,6 +33,10 @@ struct bucket {
         {"name", name},
         {"description", description},
         {"user_id", user_id},
+        {"renditions", renditions},
+        {"compression", compression},
+        {"compression_quality", compression_quality},
+        {"keep_original", keep_original},
         {"created_at", created_at},
         {"updated_at", updated_at},
     };
@@ -38,7 +53,11 @@ struct bucket {
                                              {"super", "int?"},
                                              {"name", "string"},
                                              {"description", "string"},
-                                             {"user_id", "int?"}};
+                                             {"user_id", "int?"},
+                                             {"renditions", "thumb,webp"},
+                                             {"compression", "lossy"},
+                                             {"compression_quality", 85},
+                                             {"keep_original", false}};
     static auto sample = crow::json::load(wsample.dump());
     static bool tested = false;
 
@@ -54,6 +73,42 @@ struct bucket {
     return sample;
   }
 
+  static inline std::string
+  validate_renditions(const std::string &renditions) {
+    std::string_view rest = renditions;
+    while (!rest.empty()) {
+      auto comma = rest.find(',');
+      auto name = rest.substr(0, comma);
+      auto known = false;
+      for (std::string_view rendition : constants::image::renditions) {
+        known = known || rendition == name;
+      }
+      if (!known) {
+        throw std::runtime_error("unknown rendition: " + std::string(name));
+      }
+      rest.remove_prefix(comma == std::string_view::npos ? rest.size()
+                                                         : comma + 1);
+    }
+    return renditions;
+  }
+
+  static inline std::string
+  validate_compression(const std::string &compression) {
+    for (std::string_view known : constants::image::compressions) {
+      if (compression.empty() || compression == known) {
+        return compression;
+      }
+    }
+    throw std::runtime_error("unknown compression: " + compression);
+  }
+
+  static inline int validate_quality(int quality) {
+    if (quality < 1 || quality > 100) {
+      throw std::runtime_error("compression_quality must be between 1 and 100");
+    }
+    return quality;
+  }
+
   static inline model::bucket from_json(const crow::json::rvalue &json) {
     return model::bucket{
         .id = util::json::get_or<int>(json, "id", 0),
@@ -61,7 +116,16 @@ struct bucket {
         .description = util::json::get<std::string>(json, "description"),
         .user_id = util::json::get<int>(json, "user_id"),
         .super = util::json::get_or<std::optional<decltype(model::bucket::id)>>(
-            json, "super", {})};
+            json, "super", {}),
+        .renditions = validate_renditions(
+            util::json::get_or<std::string>(json, "renditions", "")),
+        .compression = validate_compression(
+            util::json::get_or<std::string>(json, "compression", "")),
+        .compression_quality = validate_quality(util::json::get_or<int>(
+            json, "compression_quality",
+            constants::image::default_compression_quality)),
+        .keep_original =
+            util::json::get_or<bool>(json, "keep_original", false)};
   }
 
   static inline auto make_table() {
@@ -72,6 +136,12 @@ struct bucket {
         make_column("description", &bucket::description),
         make_column("user_id", &bucket::user_id),
         make_column("super", &bucket::super),
+        make_column("renditions", &bucket::renditions, default_value("")),
+        make_column("compression", &bucket::compression, default_value("")),
+        make_column("compression_quality", &bucket::compression_quality,
+                    default_value(constants::image::default_compression_quality)),
+        make_column("keep_original", &bucket::keep_original,
+                    default_value(false)),
         make_column("created_at", &bucket::created_at),
         make_column("updated_at", &bucket::updated_at),
         foreign_key(&model::bucket::user_id).references(&model::user::id));
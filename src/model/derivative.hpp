@@ -0,0 +1,58 @@
+#pragma once
+#include <crow/json.h>
+#include <cstdint>
+#include <sqlite_orm/sqlite_orm.h>
+#include <string>
+
+namespace model {
+/// Cached image transform of the blob `source` (an artifact's `filename`),
+/// stored under xbucket_derivatives_dir as `key`.
+struct derivative {
+  /// `source` and the normalized transform, see util::image::transform::key
+  std::string key;
+  std::string source;
+  std::string content_type;
+  std::int64_t size;
+  std::string created_at;
+  /// last time it was served, eviction drops the least recent first
+  std::string accessed_at;
+
+  inline crow::json::wvalue to_json() const {
+    return {
+        {"key", key},
+        {"source", source},
+        {"content_type", content_type},
+        {"size", size},
+        {"created_at", created_at},
+        {"accessed_at", accessed_at},
+    };
+  }
+
+  static inline auto make_table() {
+    using namespace sqlite_orm;
+    return sqlite_orm::make_table(
+        "derivative", make_column("key", &derivative::key, primary_key()),
+        make_column("source", &derivative::source),
+        make_column("content_type", &derivative::content_type),
+        make_column("size", &derivative::size),
+        make_column("created_at", &derivative::created_at),
+        make_column("accessed_at", &derivative::accessed_at));
+  }
+};
+
+/// Running sum of derivative sizes, a single row with id 1 that
+/// service::derivative moves with every row it adds or drops, so the
+/// budget check doesn't sum the whole table
+struct derivative_total {
+  int id;
+  std::int64_t size;
+
+  static inline auto make_table() {
+    using namespace sqlite_orm;
+    return sqlite_orm::make_table(
+        "derivative_total",
+        make_column("id", &derivative_total::id, primary_key()),
+        make_column("size", &derivative_total::size, default_value(0)));
+  }
+};
+} // namespace model
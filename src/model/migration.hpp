@@ -0,0 +1,92 @@
+#pragma once
+
+#include "crow/logging.h"
+#include "sqlite_orm/sqlite_orm.h"
+#include <stdexcept>
+#include <string>
+#include <vector>
+
+namespace model {
+/// Versioned schema step for what `sync_schema` can't do by itself (data
+/// rewrites, statistics, dropping leftovers). The version applied last is
+/// kept in `PRAGMA user_version`; steps are appended, never edited.
+struct migration {
+  int version;
+  std::string description;
+  std::string sql;
+};
+
+/// timestamps were written as sqlite's datetime() with an offset applied
+inline std::string shift_timestamps(const std::string &table,
+                                    const std::string &offset) {
+  return "UPDATE \"" + table + "\" SET created_at = coalesce(datetime(" +
+         "created_at, '" + offset + "'), created_at), updated_at = " +
+         "coalesce(datetime(updated_at, '" + offset + "'), updated_at);";
+}
+
+inline const std::vector<migration> &get_migrations() {
+  static const std::vector<migration> migrations = {
+      {1, "collect statistics for the lookup indexes", "ANALYZE;"},
+      {2, "store timestamps in UTC",
+       shift_timestamps("user", "-2 hours") +
+           shift_timestamps("bucket", "-2 hours") +
+           shift_timestamps("artifact", "-2 hours") +
+           "UPDATE \"blob\" SET created_at = "
+           "coalesce(datetime(created_at, '-2 hours'), created_at);"},
+      {3, "count existing artifacts into the usage counters",
+       "DELETE FROM bucket_usage; DELETE FROM user_usage;"
+       "INSERT INTO bucket_usage (bucket_id, artifacts, bytes, last_write_at) "
+       "SELECT artifact.bucket_id, count(*), coalesce(sum(blob.size), 0), "
+       "max(artifact.updated_at) FROM artifact "
+       "JOIN bucket ON bucket.id = artifact.bucket_id "
+       "LEFT JOIN blob ON blob.hash = artifact.filename "
+       "GROUP BY artifact.bucket_id;"
+       "INSERT INTO user_usage (user_id, artifacts, bytes, last_write_at) "
+       "SELECT bucket.user_id, sum(artifacts), sum(bytes), max(last_write_at) "
+       "FROM bucket_usage JOIN bucket ON bucket.id = bucket_usage.bucket_id "
+       "GROUP BY bucket.user_id;"},
+      {4, "sum the derivative cache into its running total",
+       "INSERT OR REPLACE INTO derivative_total (id, size) "
+       "SELECT 1, coalesce(sum(size), 0) FROM derivative;"},
+  };
+  return migrations;
+}
+
+/// Applies pending migrations on `db`, each in its own transaction. Runs
+/// after `sync_schema`, so tables and indexes already match the models.
+inline void migrate(sqlite3 *db) {
+  auto exec = [db](const std::string &sql) {
+    char *error = nullptr;
+    if (sqlite3_exec(db, sql.c_str(), nullptr, nullptr, &error) != SQLITE_OK) {
+      std::string message = error ? error : "unknown error";
+      sqlite3_free(error);
+      throw std::runtime_error(message);
+    }
+  };
+  int current = 0;
+  sqlite3_exec(
+      db, "PRAGMA user_version;",
+      [](void *version, int, char **values, char **) {
+        *static_cast<int *>(version) = values[0] ? std::stoi(values[0]) : 0;
+        return 0;
+      },
+      &current, nullptr);
+  for (const auto &step : get_migrations()) {
+    if (step.version <= current) {
+      continue;
+    }
+    CROW_LOG_INFO << "applying migration " << step.version << ": "
+                  << step.description;
+    exec("BEGIN IMMEDIATE;");
+    try {
+      exec(step.sql);
+      exec("PRAGMA user_version = " + std::to_string(step.version) + ";");
+      exec("COMMIT;");
+    } catch (std::runtime_error &e) {
+      exec("ROLLBACK;");
+      throw std::runtime_error("migration " + std::to_string(step.version) +
+                               " failed: " + e.what());
+    }
+  }
+}
+} // namespace model
@@ -1,27 +1,167 @@
 #pragma once
 
+#include "../constants/database.hpp"
 #include "../constants/filesystem.hpp"
+#include "../util/env.hpp"
+#include "../util/metrics.hpp"
 #include "artifact.hpp"
+#include "blob.hpp"
 #include "bucket.hpp"
+#include "derivative.hpp"
+#include "migration.hpp"
+#include "usage.hpp"
+#include "crow/logging.h"
 #include "sqlite_orm/sqlite_orm.h"
 #include "user.hpp"
+#include <cstdint>
+#include <memory>
+#include <mutex>
+#include <stdexcept>
 #include <string>
+#include <unordered_map>
 
 namespace model {
 
-inline auto
-get_storage(const std::string &path = constants::filesystem::xbucket_db_name) {
+struct storage_options {
+  std::string synchronous;
+  std::int64_t mmap_size;
+  int cache_size;
+  int busy_timeout;
 
+  static storage_options from_env() {
+    using namespace constants::database;
+    return {
+        .synchronous = util::env::get_or<std::string>("XBUCKET_DB_SYNCHRONOUS",
+                                                      synchronous),
+        .mmap_size = util::env::get_or("XBUCKET_DB_MMAP_SIZE", mmap_size),
+        .cache_size = util::env::get_or("XBUCKET_DB_CACHE_SIZE", cache_size),
+        .busy_timeout =
+            util::env::get_or("XBUCKET_DB_BUSY_TIMEOUT", busy_timeout),
+    };
+  }
+
+  /// pragmas run on every new connection
+  std::string to_sql() const {
+    if (synchronous != "OFF" && synchronous != "NORMAL" &&
+        synchronous != "FULL" && synchronous != "EXTRA") {
+      throw std::runtime_error("invalid synchronous mode: " + synchronous);
+    }
+    return "PRAGMA journal_mode = WAL;"
+           "PRAGMA synchronous = " +
+           synchronous +
+           ";"
+           "PRAGMA mmap_size = " +
+           std::to_string(mmap_size) +
+           ";"
+           "PRAGMA cache_size = " +
+           std::to_string(cache_size) +
+           ";"
+           "PRAGMA temp_store = MEMORY;";
+  }
+};
+
+inline auto make_storage(const std::string &path) {
   using namespace sqlite_orm;
-  static auto did_storage_init = false;
-  static auto storage = make_storage(
-      constants::filesystem::xbucket_db_dir + path, user::make_table(),
-      bucket::make_table(), artifact::make_table());
-  if (!did_storage_init) {
-    storage.sync_schema();
-    did_storage_init = true;
+  return sqlite_orm::make_storage(
+      path,
+      // artifacts of a bucket in id order: cascades and keyset pages
+      make_index("artifact_bucket_id", &artifact::bucket_id, &artifact::id),
+      make_index("artifact_super", &artifact::super),
+      // artifacts sharing a blob
+      make_index("artifact_filename", &artifact::filename),
+      // buckets of a user in id order, covers the ownership checks
+      make_index("bucket_user_id", &bucket::user_id, &bucket::id),
+      make_index("bucket_super", &bucket::super),
+      make_index("user_super", &user::super),
+      // unreferenced blobs, the reclaimer's scan
+      make_index("blob_unreferenced", &blob::refs,
+                 where(c(&blob::refs) <= 0)),
+      // invalidation by source, eviction in access order
+      make_index("derivative_source", &derivative::source),
+      make_index("derivative_accessed_at", &derivative::accessed_at),
+      user::make_table(), bucket::make_table(), artifact::make_table(),
+      blob::make_table(), derivative::make_table(),
+      derivative_total::make_table(), bucket_usage::make_table(),
+      user_usage::make_table());
+}
+
+using storage_type = decltype(make_storage(""));
+
+/// Hands every thread its own connection to the same database. Connections
+/// are opened on first use, kept open for the thread's lifetime and run in
+/// WAL mode so readers never wait behind a writer.
+class storage_pool {
+  struct connection {
+    std::unique_ptr<storage_type> storage;
+    sqlite3 *db = nullptr;
+  };
+
+  const std::string path;
+  const storage_options options;
+  std::once_flag schema_synced;
+
+  connection &get_connection() {
+    thread_local std::unordered_map<const storage_pool *,
+                                    std::unique_ptr<connection>>
+        connections;
+    auto &current = connections[this];
+    if (!current) {
+      current = open();
+    }
+    return *current;
   }
 
-  return storage;
+public:
+  storage_pool(std::string path, storage_options options)
+      : path(std::move(path)), options(std::move(options)) {}
+
+  storage_type &get() { return *get_connection().storage; }
+
+  /// raw handle of the calling thread's connection, for SQL sqlite_orm
+  /// can't express
+  sqlite3 *get_db() { return get_connection().db; }
+
+private:
+  std::unique_ptr<connection> open() {
+    auto result = std::make_unique<connection>();
+    result->storage = std::make_unique<storage_type>(make_storage(path));
+    result->storage->on_open = [sql = options.to_sql(),
+                                timeout = options.busy_timeout,
+                                handle = result.get()](sqlite3 *db) {
+      handle->db = db;
+      sqlite3_busy_timeout(db, timeout);
+      // SQLITE_TRACE_PROFILE reports each statement's run time in ns
+      sqlite3_trace_v2(
+          db, SQLITE_TRACE_PROFILE,
+          [](unsigned, void *, void *, void *elapsed) {
+            util::metrics::registry::instance().statements.record(
+                *static_cast<sqlite3_int64 *>(elapsed) / 1000);
+            return 0;
+          },
+          nullptr);
+      char *error = nullptr;
+      if (sqlite3_exec(db, sql.c_str(), nullptr, nullptr, &error) !=
+          SQLITE_OK) {
+        CROW_LOG_ERROR << "failed to configure connection: " << error;
+        sqlite3_free(error);
+      }
+    };
+    result->storage->open_forever();
+    std::call_once(schema_synced, [&] {
+      result->storage->sync_schema();
+      migrate(result->db);
+    });
+    return result;
+  }
+};
+
+inline storage_pool &
+get_storage_pool(const std::string &path = constants::filesystem::xbucket_db_name) {
+  static storage_pool pool(constants::filesystem::xbucket_db_dir + path,
+                           storage_options::from_env());
+  return pool;
 }
+
+/// the calling thread's connection
+inline storage_type &get_storage() { return get_storage_pool().get(); }
 } // namespace model
@@ -0,0 +1,79 @@
+#pragma once
+#include "bucket.hpp"
+#include "user.hpp"
+#include <crow/json.h>
+#include <cstdint>
+#include <sqlite_orm/sqlite_orm.h>
+#include <string>
+
+namespace model {
+/// Running totals of a bucket's artifacts. service::usage moves them in the
+/// transactions that add and remove artifacts, so reading them costs one
+/// primary key lookup however many files the bucket holds.
+struct bucket_usage {
+  decltype(model::bucket::id) bucket_id;
+  std::int64_t artifacts = 0;
+  /// bytes of the artifacts' content, shared content counted per artifact
+  std::int64_t bytes = 0;
+  /// when an artifact was last added or removed, empty before the first
+  std::string last_write_at;
+
+  inline crow::json::wvalue to_json() const {
+    return {
+        {"bucket_id", bucket_id},
+        {"artifacts", artifacts},
+        {"bytes", bytes},
+        {"last_write_at", last_write_at},
+    };
+  }
+
+  static inline crow::json::wvalue to_json_sample() {
+    static auto sample = bucket_usage{.bucket_id = 0}.to_json();
+    return sample;
+  }
+
+  static inline auto make_table() {
+    using namespace sqlite_orm;
+    return sqlite_orm::make_table(
+        "bucket_usage",
+        make_column("bucket_id", &bucket_usage::bucket_id, primary_key()),
+        make_column("artifacts", &bucket_usage::artifacts, default_value(0)),
+        make_column("bytes", &bucket_usage::bytes, default_value(0)),
+        make_column("last_write_at", &bucket_usage::last_write_at,
+                    default_value("")));
+  }
+};
+
+/// the same totals over all of a user's buckets
+struct user_usage {
+  decltype(model::user::id) user_id;
+  std::int64_t artifacts = 0;
+  std::int64_t bytes = 0;
+  std::string last_write_at;
+
+  inline crow::json::wvalue to_json() const {
+    return {
+        {"user_id", user_id},
+        {"artifacts", artifacts},
+        {"bytes", bytes},
+        {"last_write_at", last_write_at},
+    };
+  }
+
+  static inline crow::json::wvalue to_json_sample() {
+    static auto sample = user_usage{.user_id = 0}.to_json();
+    return sample;
+  }
+
+  static inline auto make_table() {
+    using namespace sqlite_orm;
+    return sqlite_orm::make_table(
+        "user_usage",
+        make_column("user_id", &user_usage::user_id, primary_key()),
+        make_column("artifacts", &user_usage::artifacts, default_value(0)),
+        make_column("bytes", &user_usage::bytes, default_value(0)),
+        make_column("last_write_at", &user_usage::last_write_at,
+                    default_value("")));
+  }
+};
+} // namespace model
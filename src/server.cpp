@@ -9,24 +9,35 @@
 #include "crow/common.h"
 #include "crow/http_request.h"
 #include "middleware/auth.hpp"
+#include "middleware/compression.hpp"
+#include "middleware/metrics.hpp"
 #include "model/model.hpp"
 #include "service/artifact.hpp"
 #include "service/bucket.hpp"
+#include "service/derivative.hpp"
+#include "service/reclaimer.hpp"
 #include "service/user.hpp"
+#include "util/metrics.hpp"
 #include "view/view.hpp"
 #include <crow/app.h>
 #include <cstddef>
 #include <cstdlib>
 #include <optional>
 
-using Session = crow::SessionMiddleware<crow::FileStore>;
+using Session = middleware::Session;
 
 namespace server {
 
-crow::App<crow::CookieParser, middleware::auth, Session> app{
-    Session{
-        crow::FileStore{constants::filesystem::xbucket_sessions_dir},
-    },
+/// shares its state with the copy the session middleware holds, started in
+/// run()
+middleware::session_store sessions;
+
+crow::App<crow::CookieParser, middleware::metrics, middleware::compression,
+          middleware::auth, Session>
+    app{
+        Session{
+            sessions,
+        },
 };
 
 void mount_views() {
@@ -38,7 +49,35 @@ void mount_views() {
                               .auth = false,
                               .input_sample = std::nullopt,
                               .output_sample = std::nullopt});
-  CROW_ROUTE(app, "/").methods(crow::HTTPMethod::Get)(view::index);
+  // the page embeds the api docs, so it is rendered once every controller
+  // has registered its routes and is served precompressed from then on
+  static const middleware::precompressed index{view::index(),
+                                               "text/html; charset=utf-8"};
+  CROW_ROUTE(app, "/").methods(crow::HTTPMethod::Get)(
+      [](const crow::request &req) { return index.serve(req); });
+  util::metrics::registry::instance().add_route(
+      "/", static_cast<int>(crow::HTTPMethod::Get), "GET");
+}
+
+void mount_metrics() {
+  controller::controller::routes["metrics"].push_back(
+      controller::route_descr{.name = "metrics",
+                              .route = "/metrics",
+                              .description = "Prometheus metrics",
+                              .method = crow::HTTPMethod::Get,
+                              .auth = false,
+                              .input_sample = std::nullopt,
+                              .output_sample = std::nullopt});
+  auto &registry = util::metrics::registry::instance();
+  registry.observe("xbucket_sessions", "Sessions in the session store",
+                   [] { return sessions.size(); });
+  CROW_ROUTE(app, "/metrics").methods(crow::HTTPMethod::Get)([&registry] {
+    crow::response res{registry.render()};
+    res.set_header("Content-Type", "text/plain; version=0.0.4");
+    return res;
+  });
+  registry.add_route("/metrics", static_cast<int>(crow::HTTPMethod::Get),
+                     "GET");
 }
 
 void make_directories() {
@@ -46,22 +85,30 @@ void make_directories() {
   std::filesystem::create_directories(xbucket_dir);
   std::filesystem::create_directories(xbucket_db_dir);
   std::filesystem::create_directories(xbucket_uploads_dir);
+  std::filesystem::create_directories(xbucket_derivatives_dir);
   std::filesystem::create_directories(xbucket_sessions_dir);
 }
 
 void run() {
   make_directories();
-  mount_views();
+  sessions.start();
+  app.get_middleware<middleware::compression>().configure();
+  app.get_middleware<middleware::auth>().configure();
   std::srand(std::time(NULL));
-  auto storage = model::get_storage();
-  auto us = service::user(storage);
-  auto bs = service::bucket(storage);
-  auto as = service::artifact(storage);
+  auto &pool = model::get_storage_pool();
+  auto us = service::user(pool);
+  auto bs = service::bucket(pool);
+  auto as = service::artifact(pool);
+  auto ds = service::derivative(pool);
+  service::reclaimer rs(pool);
   controller::auth ac(app, us);
   controller::user uc(app, us);
   controller::bucket bc(app, bs);
-  controller::artifact arc(app, as);
+  controller::artifact arc(app, as, ds);
   controller::docs dc(app);
+  mount_metrics();
+  mount_views();
+  dc.publish();
 
   app.bindaddr("0.0.0.0")
       .port(8080)
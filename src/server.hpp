@@ -2,5 +2,6 @@
 
 namespace server {
 void mount_views();
+void mount_metrics();
 void run();
 } // namespace server
@@ -1,42 +1,116 @@
 #pragma once
 
 #include "../model/artifact.hpp"
+#include "../model/bucket.hpp"
+#include "blob.hpp"
+#include "prepared.hpp"
+#include "sql.hpp"
+#include "usage.hpp"
+#include "../util/clock.hpp"
 #include "crow/logging.h"
 #include "sqlite_orm/sqlite_orm.h"
-#include <filesystem>
+#include <functional>
 #include <optional>
+#include <stdexcept>
 #include <string>
 #include <system_error>
 
 namespace service {
 template <typename S> class artifact {
-  S &storage;
+  S &pool;
+  blob<S> blobs;
+  usage<S> usages;
 
 public:
-  artifact(S &storage) : storage(storage) {}
+  artifact(S &pool) : pool(pool), blobs(pool), usages(pool) {}
+
+  /// Call within a transaction, the bucket and user usage counters are
+  /// moved along with the insert
   int insert(model::artifact &artifact) {
-    artifact.created_at = artifact.updated_at =
-        storage.select(sqlite_orm::datetime("now", "+2 hours")).front();
-    return artifact.id = storage.template insert<model::artifact>(artifact);
+    auto &storage = pool.get();
+    artifact.created_at = artifact.updated_at = util::clock::now();
+    artifact.id = storage.template insert<model::artifact>(artifact);
+    usages.add_matching("artifact.id = ?1", {artifact.id});
+    return artifact.id;
+  }
+
+  /// Inserts an artifact whose content was staged at `staged_path`,
+  /// `artifact.filename` must hold the content hash. Call within a transaction.
+  int insert(model::artifact &artifact, const std::string &staged_path) {
+    blobs.store(artifact.filename, staged_path);
+    return insert(artifact);
+  }
+
+  bool transaction(const std::function<bool()> &f) {
+    auto &storage = pool.get();
+    return storage.transaction(f);
+  }
+
+  /// Like transaction, but takes the write lock up front. For paths that
+  /// read before they write: a deferred transaction on a WAL connection
+  /// can't upgrade to a writer once another writer committed after its
+  /// read (SQLITE_BUSY_SNAPSHOT), and the busy timeout doesn't retry that.
+  bool immediate_transaction(const std::function<bool()> &f) {
+    auto &storage = pool.get();
+    storage.begin_immediate_transaction();
+    try {
+      if (f()) {
+        storage.commit();
+        return true;
+      }
+    } catch (...) {
+      storage.rollback();
+      throw;
+    }
+    storage.rollback();
+    return false;
   }
 
+  /// Saves the artifact. When it moves to another bucket or points at other
+  /// content, the usage counts and the blob references follow it; other
+  /// content must already be a stored blob. Cached derivatives belong to
+  /// the blob, the reclaimer drops them once no artifact points at it.
+  /// Call within an immediate_transaction, it reads the stored row before
+  /// writing. Throws when the new content isn't stored.
   void update(model::artifact &artifact) {
-    artifact.updated_at =
-        storage.select(sqlite_orm::datetime("now", "+2 hours")).front();
+    auto &storage = pool.get();
+    artifact.updated_at = util::clock::now();
+    auto stored = storage.template get_pointer<model::artifact>(artifact.id);
+    if (!stored || (stored->bucket_id == artifact.bucket_id &&
+                    stored->filename == artifact.filename)) {
+      storage.template update<model::artifact>(artifact);
+      return;
+    }
+    if (stored->filename != artifact.filename) {
+      // take the new reference first, the old blob may be the only copy
+      if (!blobs.retain(artifact.filename)) {
+        throw std::runtime_error("Artifact content not found");
+      }
+      blobs.release(stored->filename);
+    }
+    usages.release_matching("artifact.id = ?1", {artifact.id});
     storage.template update<model::artifact>(artifact);
+    usages.add_matching("artifact.id = ?1", {artifact.id});
   }
 
   std::optional<model::artifact> get_with_bucket_and_user(int id, int bucket_id,
                                                           int user_id) {
+    auto &storage = pool.get();
     using namespace sqlite_orm;
     try {
-      auto data = storage.template get_all<model::artifact>(
-          where(c(&model::artifact::id) == id and
-                c(&model::artifact::bucket_id) ==
-                    select(&model::bucket::id,
-                           where(c(&model::bucket::id) == bucket_id and
-                                 c(&model::bucket::user_id) == user_id),
-                           limit(1))));
+      auto &statement = prepared(storage, [] {
+        return get_all<model::artifact>(
+            where(c(&model::artifact::id) == 0 and
+                  c(&model::artifact::bucket_id) ==
+                      select(&model::bucket::id,
+                             where(c(&model::bucket::id) == 0 and
+                                   c(&model::bucket::user_id) == 0),
+                             limit(1))));
+      });
+      sqlite_orm::get<0>(statement) = id;
+      sqlite_orm::get<1>(statement) = bucket_id;
+      sqlite_orm::get<2>(statement) = user_id;
+      auto data = storage.execute(statement);
       if (data.size() == 1) {
         return std::move(data.front());
       }
@@ -46,23 +120,96 @@ public:
     return {};
   }
 
-  void remove(const model::artifact &artifact) {
+  /// the bucket artifacts are uploaded to, for its image policies
+  std::optional<model::bucket> get_bucket(int bucket_id) {
+    auto &storage = pool.get();
     using namespace sqlite_orm;
-    if (std::filesystem::remove(artifact.filename)) {
-      CROW_LOG_INFO << "Artifact file removed: " << artifact.filename;
-    } else {
-      CROW_LOG_ERROR << "Failed to remove artifact file: " << artifact.filename;
+    auto &statement = prepared(storage, [] {
+      return get_all<model::bucket>(where(c(&model::bucket::id) == 0),
+                                    limit(1));
+    });
+    sqlite_orm::get<0>(statement) = bucket_id;
+    auto data = storage.execute(statement);
+    if (data.empty()) {
+      return {};
     }
-    storage.template remove_all<model::artifact>(
-        where(c(&model::artifact::id) == artifact.id));
+    return std::move(data.front());
+  }
+
+  bool owns_bucket(int bucket_id, int user_id) {
+    auto &storage = pool.get();
+    using namespace sqlite_orm;
+    auto &statement = prepared(storage, [] {
+      return select(&model::bucket::id,
+                    where(c(&model::bucket::id) == 0 and
+                          c(&model::bucket::user_id) == 0),
+                    limit(1));
+    });
+    sqlite_orm::get<0>(statement) = bucket_id;
+    sqlite_orm::get<1>(statement) = user_id;
+    return !storage.execute(statement).empty();
+  }
+
+  /// Ids of artifact `?1` and every artifact below it: multipart parts and
+  /// the originals kept beside recompressed uploads
+  static constexpr auto subtree =
+      "WITH RECURSIVE subtree(id) AS ("
+      "SELECT id FROM artifact WHERE id = ?1 "
+      "UNION SELECT artifact.id FROM artifact JOIN subtree "
+      "ON artifact.super = subtree.id) ";
+
+  /// Removes the artifact, and with `recursive` the artifacts below it too.
+  /// Returns false when the transaction was rolled back.
+  bool remove(const model::artifact &artifact, bool recursive = false) {
+    auto &storage = pool.get();
+    const auto matching =
+        recursive ? std::string("IN (") + subtree + "SELECT id FROM subtree)"
+                  : std::string("= ?1");
+    return storage.transaction([&] mutable {
+      try {
+        blobs.release_matching("artifact.id " + matching, {artifact.id});
+        usages.release_matching("artifact.id " + matching, {artifact.id});
+        execute(pool, "DELETE FROM artifact WHERE id " + matching,
+                {artifact.id});
+        return true;
+      } catch (std::system_error &e) {
+        CROW_LOG_ERROR << __FUNCTION__ << ": " << e.what();
+        return false;
+      }
+    });
+  }
+
+  /// Up to `count` of the bucket's artifacts with an id above `after`, in id
+  /// order, whose name starts with `prefix`. Walks the (bucket_id, id) index,
+  /// so deep pages cost the same as the first one.
+  std::vector<model::artifact> list(int bucket_id, int after,
+                                    const std::string &prefix, int count) {
+    auto &storage = pool.get();
+    using namespace sqlite_orm;
+    auto &statement = prepared(storage, [] {
+      return get_all<model::artifact>(
+          where(c(&model::artifact::bucket_id) == 0 and
+                c(&model::artifact::id) > 0 and
+                c(substr(&model::artifact::name, 1,
+                         length(std::string()))) == std::string()),
+          order_by(&model::artifact::id), limit(0));
+    });
+    sqlite_orm::get<0>(statement) = bucket_id;
+    sqlite_orm::get<1>(statement) = after;
+    sqlite_orm::get<3>(statement) = prefix;
+    sqlite_orm::get<4>(statement) = prefix;
+    sqlite_orm::get<5>(statement) = count;
+    return storage.execute(statement);
   }
 
   std::vector<model::artifact> get_children(model::artifact &artifact) {
+    auto &storage = pool.get();
     using namespace sqlite_orm;
     return storage.template get_all<model::artifact>(
         where(c(&model::artifact::super) == artifact.id));
   }
 
+  /// Call within a transaction, see update
   int add_child(const model::artifact &artifact,
                 model::artifact &sub_artifact) {
     sub_artifact.super = artifact.id;
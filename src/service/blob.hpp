@@ -0,0 +1,101 @@
+#pragma once
+
+#include "../constants/filesystem.hpp"
+#include "../model/blob.hpp"
+#include "../util/clock.hpp"
+#include "sql.hpp"
+#include "crow/logging.h"
+#include "sqlite_orm/sqlite_orm.h"
+#include <cstdint>
+#include <filesystem>
+#include <optional>
+#include <string>
+#include <system_error>
+#include <vector>
+
+namespace service {
+/// Reference counted, content addressed files. Every method that changes
+/// `refs` is expected to run inside the caller's transaction so the count
+/// and the rows pointing at the blob move together. A blob whose count
+/// drops to zero is a tombstone, `reclaimer` unlinks it in the background.
+template <typename S> class blob {
+  S &pool;
+
+public:
+  blob(S &pool) : pool(pool) {}
+
+  static std::string path(const std::string &hash) {
+    return constants::filesystem::xbucket_uploads_dir + hash;
+  }
+
+  /// Takes a reference on `hash`. The staged file becomes the blob when it is
+  /// the first copy of that content, otherwise it is discarded. The rename
+  /// happens before the caller commits; if it rolls back instead, the file
+  /// is left without a row and reclaimer::collect unlinks it once it is
+  /// older than the grace period, unless the same content is stored again.
+  void store(const std::string &hash, const std::string &staged_path) {
+    auto &storage = pool.get();
+    using namespace sqlite_orm;
+    // write first so the transaction holds the write lock before the
+    // existence check, a concurrent release can't unlink the blob under us
+    storage.update_all(set(c(&model::blob::refs) = c(&model::blob::refs) + 1),
+                       where(c(&model::blob::hash) == hash));
+    if (storage.changes()) {
+      std::error_code ec;
+      std::filesystem::remove(staged_path, ec);
+      return;
+    }
+    auto size = (std::int64_t)std::filesystem::file_size(staged_path);
+    std::filesystem::rename(staged_path, path(hash));
+    storage.replace(model::blob{
+        .hash = hash,
+        .size = size,
+        .refs = 1,
+        .created_at = util::clock::now()});
+  }
+
+  /// Takes another reference on the stored blob `hash`, false when there is
+  /// no such blob
+  bool retain(const std::string &hash) {
+    auto &storage = pool.get();
+    using namespace sqlite_orm;
+    storage.update_all(set(c(&model::blob::refs) = c(&model::blob::refs) + 1),
+                       where(c(&model::blob::hash) == hash));
+    return storage.changes() > 0;
+  }
+
+  /// Drops a reference on `hash`, the file stays until it is reclaimed.
+  /// The count stops at zero, a row predating reference counting has
+  /// nothing to release.
+  void release(const std::string &hash) {
+    auto &storage = pool.get();
+    using namespace sqlite_orm;
+    storage.update_all(set(c(&model::blob::refs) = c(&model::blob::refs) - 1),
+                       where(c(&model::blob::hash) == hash and
+                             c(&model::blob::refs) > 0));
+  }
+
+  /// Drops the references of every artifact matching `artifacts`, a
+  /// condition on the artifact table over `params` (`?1`, `?2`...), in one
+  /// statement however many artifacts match
+  void release_matching(const std::string &artifacts,
+                        const std::vector<std::int64_t> &params) {
+    execute(pool,
+            "UPDATE blob SET refs = max(0, refs - (SELECT count(*) FROM "
+            "artifact WHERE artifact.filename = blob.hash AND " +
+                artifacts +
+                ")) WHERE hash IN (SELECT filename FROM artifact WHERE " +
+                artifacts + ")",
+            params);
+  }
+
+  std::optional<model::blob> get(const std::string &hash) {
+    auto &storage = pool.get();
+    try {
+      return std::move(storage.template get<model::blob>(hash));
+    } catch (std::system_error &e) {
+      return {};
+    }
+  }
+};
+} // namespace service
@@ -2,36 +2,50 @@
 
 #include "../model/artifact.hpp"
 #include "../model/bucket.hpp"
+#include "blob.hpp"
+#include "prepared.hpp"
+#include "sql.hpp"
+#include "usage.hpp"
+#include "../util/clock.hpp"
 #include "crow/logging.h"
 #include "sqlite_orm/sqlite_orm.h"
+#include <cstdint>
 #include <optional>
 #include <string>
 #include <system_error>
+#include <vector>
 
 namespace service {
 template <typename S> class bucket {
-  S &storage;
+  S &pool;
+  blob<S> blobs;
+  usage<S> usages;
 
 public:
-  bucket(S &storage) : storage(storage) {}
+  bucket(S &pool) : pool(pool), blobs(pool), usages(pool) {}
   int insert(model::bucket &bucket) {
-    bucket.created_at = bucket.updated_at =
-        storage.select(sqlite_orm::datetime("now", "+2 hours")).front();
+    auto &storage = pool.get();
+    bucket.created_at = bucket.updated_at = util::clock::now();
     return bucket.id = storage.template insert<model::bucket>(bucket);
   }
 
   void update(model::bucket &bucket) {
-    bucket.updated_at =
-        storage.select(sqlite_orm::datetime("now", "+2 hours")).front();
+    auto &storage = pool.get();
+    bucket.updated_at = util::clock::now();
     storage.template update<model::bucket>(bucket);
   }
 
   std::optional<model::bucket> get_with_user(int id, int user_id) {
+    auto &storage = pool.get();
     using namespace sqlite_orm;
     try {
-      auto data = storage.template get_all<model::bucket>(
-          where(c(&model::bucket::id) == id and
-                c(&model::bucket::user_id) == user_id));
+      auto &statement = prepared(storage, [] {
+        return get_all<model::bucket>(where(c(&model::bucket::id) == 0 and
+                                            c(&model::bucket::user_id) == 0));
+      });
+      sqlite_orm::get<0>(statement) = id;
+      sqlite_orm::get<1>(statement) = user_id;
+      auto data = storage.execute(statement);
       if (data.size() == 1) {
         return std::move(data.front());
       }
@@ -41,22 +55,113 @@ public:
     return {};
   }
 
-  void remove(const model::bucket &bucket) {
-    using namespace sqlite_orm;
-    storage.transaction([&] mutable {
+  /// Ids of bucket `?1` and every bucket below it, all owned by user `?2`.
+  /// UNION rather than UNION ALL, so a cycle in `super` ends the recursion.
+  static constexpr auto subtree =
+      "WITH RECURSIVE subtree(id) AS ("
+      "SELECT id FROM bucket WHERE id = ?1 AND user_id = ?2 "
+      "UNION SELECT bucket.id FROM bucket JOIN subtree "
+      "ON bucket.super = subtree.id WHERE bucket.user_id = ?2) ";
+
+  /// Removes the bucket along with its sub-buckets and all their artifacts,
+  /// false when the transaction was rolled back
+  bool remove(const model::bucket &bucket) {
+    auto &storage = pool.get();
+    const auto in_subtree =
+        std::string("IN (") + subtree + "SELECT id FROM subtree)";
+    const std::vector<std::int64_t> params{bucket.id, bucket.user_id};
+    return storage.transaction([&] mutable {
       try {
-        storage.template remove_all<model::artifact>(
-            where(c(&model::artifact::bucket_id) == bucket.id));
-        storage.template remove_all<model::bucket>(
-            where(c(&model::bucket::id) == bucket.id));
+        // files and their derivatives are reclaimed in the background
+        blobs.release_matching("artifact.bucket_id " + in_subtree, params);
+        usages.release_matching("artifact.bucket_id " + in_subtree, params);
+        usages.forget_matching("bucket.id " + in_subtree, params);
+        execute(pool, "DELETE FROM artifact WHERE bucket_id " + in_subtree,
+                params);
+        execute(pool, "DELETE FROM bucket WHERE id " + in_subtree, params);
         return true;
       } catch (std::system_error &e) {
+        CROW_LOG_ERROR << __FUNCTION__ << ": " << e.what();
         return false;
       }
     });
   }
 
+  /// the bucket and every bucket below it, in id order
+  std::vector<model::bucket> get_subtree(int id, int user_id) {
+    auto &storage = pool.get();
+    using namespace sqlite_orm;
+    std::vector<int> ids;
+    query(pool, std::string(subtree) + "SELECT id FROM subtree",
+          {id, user_id}, [&ids](sqlite3_stmt *row) {
+            ids.push_back(sqlite3_column_int(row, 0));
+          });
+    if (ids.empty()) {
+      return {};
+    }
+    return storage.template get_all<model::bucket>(
+        where(in(&model::bucket::id, ids)), order_by(&model::bucket::id));
+  }
+
+  struct subtree_stats {
+    std::int64_t buckets;
+    std::int64_t artifacts;
+    /// bytes of the artifacts' content, shared content counted per artifact
+    std::int64_t size;
+  };
+
+  /// counts and size of the bucket and everything below it, nullopt when
+  /// the user has no such bucket
+  std::optional<subtree_stats> get_subtree_stats(int id, int user_id) {
+    subtree_stats stats{};
+    query(pool,
+          std::string(subtree) +
+              "SELECT (SELECT count(*) FROM subtree), "
+              "(SELECT count(*) FROM artifact WHERE bucket_id IN "
+              "(SELECT id FROM subtree)), "
+              "(SELECT coalesce(sum(blob.size), 0) FROM artifact JOIN blob "
+              "ON blob.hash = artifact.filename WHERE artifact.bucket_id IN "
+              "(SELECT id FROM subtree))",
+          {id, user_id}, [&stats](sqlite3_stmt *row) {
+            stats = {sqlite3_column_int64(row, 0),
+                     sqlite3_column_int64(row, 1),
+                     sqlite3_column_int64(row, 2)};
+          });
+    if (stats.buckets == 0) {
+      return {};
+    }
+    return stats;
+  }
+
+  /// the bucket's usage counters, nullopt when the user has no such bucket
+  std::optional<model::bucket_usage> get_usage(int id, int user_id) {
+    return usages.get_bucket(id, user_id);
+  }
+
+  /// up to `count` of the user's buckets with an id above `after`, in id
+  /// order, whose name starts with `prefix`
+  std::vector<model::bucket> list(int user_id, int after,
+                                  const std::string &prefix, int count) {
+    auto &storage = pool.get();
+    using namespace sqlite_orm;
+    auto &statement = prepared(storage, [] {
+      return get_all<model::bucket>(
+          where(c(&model::bucket::user_id) == 0 and
+                c(&model::bucket::id) > 0 and
+                c(substr(&model::bucket::name, 1, length(std::string()))) ==
+                    std::string()),
+          order_by(&model::bucket::id), limit(0));
+    });
+    sqlite_orm::get<0>(statement) = user_id;
+    sqlite_orm::get<1>(statement) = after;
+    sqlite_orm::get<3>(statement) = prefix;
+    sqlite_orm::get<4>(statement) = prefix;
+    sqlite_orm::get<5>(statement) = count;
+    return storage.execute(statement);
+  }
+
   std::vector<model::bucket> get_children(model::bucket &bucket) {
+    auto &storage = pool.get();
     using namespace sqlite_orm;
     return storage.template get_all<model::bucket>(
         where(c(&model::bucket::super) == bucket.id));
@@ -0,0 +1,200 @@
+#pragma once
+
+#include "../constants/filesystem.hpp"
+#include "../constants/image.hpp"
+#include "../model/derivative.hpp"
+#include "../util/clock.hpp"
+#include "../util/env.hpp"
+#include "crow/logging.h"
+#include "prepared.hpp"
+#include "sql.hpp"
+#include "sqlite_orm/sqlite_orm.h"
+#include <cstdint>
+#include <filesystem>
+#include <fstream>
+#include <functional>
+#include <optional>
+#include <string>
+#include <string_view>
+#include <system_error>
+#include <thread>
+
+namespace service {
+/// Disk cache of image transforms, keyed by source content hash and
+/// transform. Rows track size and last access so the cache stays under
+/// `budget` bytes by evicting the least recently served entries; their sum
+/// is kept in derivative_total as rows come and go.
+template <typename S> class derivative {
+  S &pool;
+  std::int64_t budget;
+
+  static void unlink(const std::string &key) {
+    std::error_code ec;
+    std::filesystem::remove(path(key), ec);
+  }
+
+  /// adds `delta` to the running total and returns the new total
+  std::int64_t add_to_total(std::int64_t delta) {
+    std::int64_t total = 0;
+    query(pool,
+          "INSERT INTO derivative_total (id, size) VALUES (1, ?1) "
+          "ON CONFLICT (id) DO UPDATE SET size = size + excluded.size "
+          "RETURNING size",
+          {delta},
+          [&total](sqlite3_stmt *row) { total = sqlite3_column_int64(row, 0); });
+    return total;
+  }
+
+  /// drops the row of `key` and takes its size off the total, unless
+  /// another thread dropped it first
+  bool forget(const std::string &key, std::int64_t size) {
+    auto &storage = pool.get();
+    using namespace sqlite_orm;
+    storage.template remove_all<model::derivative>(
+        where(c(&model::derivative::key) == key));
+    if (!storage.changes()) {
+      return false;
+    }
+    add_to_total(-size);
+    return true;
+  }
+
+public:
+  derivative(S &pool)
+      : pool(pool), budget(util::env::get_or("XBUCKET_IMAGE_CACHE_SIZE",
+                                             constants::image::cache_size)) {}
+
+  static std::string path(const std::string &key) {
+    return constants::filesystem::xbucket_derivatives_dir + key;
+  }
+
+  /// The bytes of the cached `key`, nullopt once its file is gone. Read
+  /// them before answering rather than handing crow the path: eviction may
+  /// unlink the file before crow opens it.
+  static std::optional<std::string> read(const std::string &key) {
+    std::ifstream file(path(key), std::ios::binary | std::ios::ate);
+    if (!file) {
+      return {};
+    }
+    std::string data(static_cast<std::size_t>(file.tellg()), '\0');
+    if (!file.seekg(0) || !file.read(data.data(), data.size())) {
+      return {};
+    }
+    return data;
+  }
+
+  /// the cached entry when both its row and its file are there, and records
+  /// the access
+  std::optional<model::derivative> get(const std::string &key) {
+    auto &storage = pool.get();
+    using namespace sqlite_orm;
+    auto &statement = prepared(storage, [] {
+      return get_all<model::derivative>(
+          where(c(&model::derivative::key) == ""), limit(1));
+    });
+    sqlite_orm::get<0>(statement) = key;
+    auto data = storage.execute(statement);
+    if (data.empty()) {
+      return {};
+    }
+    auto &found = data.front();
+    std::error_code ec;
+    if (!std::filesystem::exists(path(key), ec)) {
+      forget(key, found.size);
+      return {};
+    }
+    // hits are frequent, their access time only needs to be roughly right
+    auto stale = util::clock::format(util::clock::epoch() -
+                                     constants::image::cache_touch_interval);
+    if (found.accessed_at < stale) {
+      storage.update_all(
+          set(c(&model::derivative::accessed_at) = util::clock::now()),
+          where(c(&model::derivative::key) == key));
+    }
+    return std::move(found);
+  }
+
+  /// Writes `data` as the derivative `key` of `source` and evicts what no
+  /// longer fits in the budget
+  void store(const std::string &key, const std::string &source,
+             const std::string &content_type, std::string_view data) {
+    auto &storage = pool.get();
+    using namespace sqlite_orm;
+    // concurrent misses for the same key each write their own file, the
+    // rename makes whichever finishes last the cached one
+    auto staged = path(key) + ".staged." +
+                  std::to_string(std::hash<std::thread::id>{}(
+                      std::this_thread::get_id()));
+    {
+      std::ofstream file(staged, std::ios::binary | std::ios::trunc);
+      if (!file.write(data.data(), data.size())) {
+        CROW_LOG_ERROR << "Failed to cache derivative: " << key;
+        std::error_code ec;
+        std::filesystem::remove(staged, ec);
+        return;
+      }
+    }
+    std::filesystem::rename(staged, path(key));
+    auto now = util::clock::now();
+    std::int64_t total = 0;
+    storage.transaction([&] mutable {
+      // a replaced row gives its size back
+      auto replaced =
+          storage.template get_pointer<model::derivative>(key);
+      storage.replace(model::derivative{.key = key,
+                                        .source = source,
+                                        .content_type = content_type,
+                                        .size = (std::int64_t)data.size(),
+                                        .created_at = now,
+                                        .accessed_at = now});
+      total = add_to_total((std::int64_t)data.size() -
+                           (replaced ? replaced->size : 0));
+      return true;
+    });
+    if (total > budget) {
+      evict(total - budget);
+    }
+  }
+
+  /// Drops the least recently served entries until `excess` bytes are
+  /// freed. They are read a batch at a time off the accessed_at index, so a
+  /// store over budget only looks at the few entries it pushes out.
+  void evict(std::int64_t excess) {
+    auto &storage = pool.get();
+    using namespace sqlite_orm;
+    auto &statement = prepared(storage, [] {
+      return select(columns(&model::derivative::key, &model::derivative::size),
+                    order_by(&model::derivative::accessed_at),
+                    limit(constants::image::eviction_batch));
+    });
+    while (excess > 0) {
+      auto oldest = storage.execute(statement);
+      if (oldest.empty()) {
+        return;
+      }
+      for (auto &[key, size] : oldest) {
+        if (excess <= 0) {
+          return;
+        }
+        if (forget(key, size)) {
+          unlink(key);
+          excess -= size;
+        }
+      }
+    }
+  }
+
+  /// forgets every derivative of the blob `source`
+  void invalidate(const std::string &source) {
+    auto &storage = pool.get();
+    using namespace sqlite_orm;
+    for (auto &[key, size] : storage.select(
+             columns(&model::derivative::key, &model::derivative::size),
+             where(c(&model::derivative::source) == source))) {
+      if (forget(key, size)) {
+        unlink(key);
+      }
+    }
+  }
+};
+} // namespace service
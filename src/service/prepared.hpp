@@ -0,0 +1,27 @@
+#pragma once
+
+#include "sqlite_orm/sqlite_orm.h"
+#include <memory>
+#include <unordered_map>
+
+namespace service {
+/// Returns the prepared statement built by `make_query`, compiling it only
+/// the first time a connection runs it. Every call site passes its own
+/// lambda, so the lambda type is the cache key for the query shape. Callers
+/// rebind the values with `sqlite_orm::get<N>(statement) = value` (qualified,
+/// services have a `get` member of their own) before executing it.
+template <typename Storage, typename Query>
+auto &prepared(Storage &storage, Query make_query) {
+  using statement_type = decltype(storage.prepare(make_query()));
+  // connections are per thread, so are their statements
+  thread_local std::unordered_map<const Storage *,
+                                  std::unique_ptr<statement_type>>
+      statements;
+  auto &statement = statements[&storage];
+  if (!statement) {
+    statement =
+        std::make_unique<statement_type>(storage.prepare(make_query()));
+  }
+  return *statement;
+}
+} // namespace service
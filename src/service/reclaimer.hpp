@@ -0,0 +1,190 @@
+#pragma once
+
+#include "../constants/filesystem.hpp"
+#include "../constants/reclaim.hpp"
+#include "../model/artifact.hpp"
+#include "../model/blob.hpp"
+#include "../model/derivative.hpp"
+#include "../util/env.hpp"
+#include "blob.hpp"
+#include "crow/logging.h"
+#include "derivative.hpp"
+#include "sqlite_orm/sqlite_orm.h"
+#include <chrono>
+#include <condition_variable>
+#include <cstddef>
+#include <exception>
+#include <filesystem>
+#include <mutex>
+#include <string>
+#include <system_error>
+#include <thread>
+#include <vector>
+
+namespace service {
+/// Background thread freeing disk space. Deletes only drop blob
+/// references; every `interval` seconds the blobs left without any are
+/// unlinked in batches along with their derivatives. Every `gc_interval`
+/// seconds the upload and derivative directories are reconciled with the
+/// database, removing files no row accounts for (abandoned staged uploads,
+/// files of rows deleted before blobs were reference counted).
+template <typename S> class reclaimer {
+  S &pool;
+  derivative<S> derivatives;
+  const int interval;
+  const int gc_interval;
+
+  std::mutex mutex;
+  std::condition_variable stopping;
+  bool stopped = false;
+  std::thread worker;
+
+  static bool is_orphan_candidate(const std::filesystem::directory_entry &entry,
+                                  std::filesystem::file_time_type cutoff) {
+    std::error_code ec;
+    return entry.is_regular_file(ec) && entry.last_write_time(ec) < cutoff &&
+           !ec;
+  }
+
+  static bool is_staged(const std::string &name) {
+    return name.find(".staged.") != std::string::npos;
+  }
+
+  void run() {
+    auto next_collect = std::chrono::steady_clock::now();
+    auto wait = std::chrono::seconds(interval);
+    std::unique_lock lock(mutex);
+    while (!stopping.wait_for(lock, wait, [this] { return stopped; })) {
+      lock.unlock();
+      std::size_t reclaimed = 0;
+      try {
+        reclaimed = reclaim(constants::reclaim::batch);
+        if (gc_interval > 0 && std::chrono::steady_clock::now() >= next_collect) {
+          collect();
+          next_collect = std::chrono::steady_clock::now() +
+                         std::chrono::seconds(gc_interval);
+        }
+      } catch (std::exception &e) {
+        CROW_LOG_ERROR << "reclaimer: " << e.what();
+      }
+      // a full batch means more are waiting
+      wait = std::chrono::seconds(
+          reclaimed == constants::reclaim::batch ? 0 : interval);
+      lock.lock();
+    }
+  }
+
+public:
+  reclaimer(S &pool)
+      : pool(pool), derivatives(pool),
+        interval(util::env::get_or("XBUCKET_RECLAIM_INTERVAL",
+                                   constants::reclaim::interval)),
+        gc_interval(util::env::get_or("XBUCKET_GC_INTERVAL",
+                                      constants::reclaim::gc_interval)) {
+    worker = std::thread([this] { run(); });
+  }
+
+  ~reclaimer() {
+    {
+      std::lock_guard lock(mutex);
+      stopped = true;
+    }
+    stopping.notify_all();
+    worker.join();
+  }
+
+  /// Unlinks up to `batch` blobs no artifact references and returns how
+  /// many. Candidates are read without the write lock; each row is then
+  /// deleted only if it is still unreferenced, together with its file in
+  /// one transaction, so an upload of the same content either revives the
+  /// blob first or stores a new file after it.
+  std::size_t reclaim(std::size_t batch) {
+    auto &storage = pool.get();
+    using namespace sqlite_orm;
+    // refs <= 0 is the blob_unreferenced partial index, the artifact check
+    // goes through artifact_filename
+    auto candidates = storage.select(
+        &model::blob::hash,
+        where(c(&model::blob::refs) <= 0 and
+              not exists(select(&model::artifact::id,
+                                where(is_equal(&model::artifact::filename,
+                                               &model::blob::hash))))),
+        limit(batch));
+    if (candidates.empty()) {
+      return 0;
+    }
+    std::vector<std::string> reclaimed;
+    storage.transaction([&] mutable {
+      for (auto &hash : candidates) {
+        storage.template remove_all<model::blob>(
+            where(c(&model::blob::hash) == hash and
+                  c(&model::blob::refs) <= 0));
+        if (!storage.changes()) {
+          continue;
+        }
+        std::error_code ec;
+        if (!std::filesystem::remove(blob<S>::path(hash), ec) && ec) {
+          CROW_LOG_ERROR << "Failed to remove artifact file: " << hash;
+        }
+        reclaimed.push_back(hash);
+      }
+      return true;
+    });
+    for (const auto &hash : reclaimed) {
+      derivatives.invalidate(hash);
+    }
+    if (!reclaimed.empty()) {
+      CROW_LOG_INFO << "reclaimed " << reclaimed.size() << " artifact files";
+    }
+    return reclaimed.size();
+  }
+
+  /// Removes files older than the grace period that neither a blob, an
+  /// artifact nor a derivative row accounts for, returns how many
+  std::size_t collect() {
+    auto &storage = pool.get();
+    using namespace sqlite_orm;
+    namespace fs = std::filesystem;
+    const auto cutoff = fs::file_time_type::clock::now() -
+                        std::chrono::seconds(constants::reclaim::grace);
+    std::size_t removed = 0;
+    auto remove = [&removed](const fs::path &path) {
+      std::error_code ec;
+      if (fs::remove(path, ec)) {
+        removed++;
+      }
+    };
+    std::error_code ec;
+    for (const auto &entry : fs::directory_iterator(
+             constants::filesystem::xbucket_uploads_dir, ec)) {
+      if (!is_orphan_candidate(entry, cutoff)) {
+        continue;
+      }
+      const auto name = entry.path().filename().string();
+      // staged uploads are renamed into place once stored
+      if (is_staged(name) ||
+          (!storage.template count<model::blob>(
+               where(c(&model::blob::hash) == name)) &&
+           !storage.template count<model::artifact>(
+               where(c(&model::artifact::filename) == name)))) {
+        remove(entry.path());
+      }
+    }
+    for (const auto &entry : fs::directory_iterator(
+             constants::filesystem::xbucket_derivatives_dir, ec)) {
+      if (!is_orphan_candidate(entry, cutoff)) {
+        continue;
+      }
+      const auto name = entry.path().filename().string();
+      if (is_staged(name) || !storage.template count<model::derivative>(
+                                 where(c(&model::derivative::key) == name))) {
+        remove(entry.path());
+      }
+    }
+    if (removed) {
+      CROW_LOG_INFO << "collected " << removed << " orphaned files";
+    }
+    return removed;
+  }
+};
+} // namespace service
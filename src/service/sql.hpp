@@ -0,0 +1,41 @@
+#pragma once
+
+#include "sqlite_orm/sqlite_orm.h"
+#include <cstdint>
+#include <string>
+#include <system_error>
+#include <vector>
+
+namespace service {
+/// Runs `sql` on the calling thread's connection of `pool`, for what
+/// sqlite_orm can't express (recursive CTEs, correlated updates). `params`
+/// bind to `?1`, `?2`, ... and `row` is called with the statement for every
+/// result row. Errors throw std::system_error like sqlite_orm does.
+template <typename S, typename Row>
+void query(S &pool, const std::string &sql,
+           const std::vector<std::int64_t> &params, Row row) {
+  auto *db = pool.get_db();
+  sqlite3_stmt *statement = nullptr;
+  auto rc = sqlite3_prepare_v2(db, sql.c_str(), -1, &statement, nullptr);
+  for (std::size_t i = 0; rc == SQLITE_OK && i < params.size(); i++) {
+    rc = sqlite3_bind_int64(statement, i + 1, params[i]);
+  }
+  if (rc == SQLITE_OK) {
+    while ((rc = sqlite3_step(statement)) == SQLITE_ROW) {
+      row(statement);
+    }
+  }
+  sqlite3_finalize(statement);
+  if (rc != SQLITE_DONE) {
+    throw std::system_error(rc, sqlite_orm::get_sqlite_error_category(),
+                            sqlite3_errmsg(db));
+  }
+}
+
+/// `query` for statements without results
+template <typename S>
+void execute(S &pool, const std::string &sql,
+             const std::vector<std::int64_t> &params) {
+  query(pool, sql, params, [](sqlite3_stmt *) {});
+}
+} // namespace service
@@ -0,0 +1,134 @@
+#pragma once
+
+#include "../model/bucket.hpp"
+#include "../model/usage.hpp"
+#include "../util/clock.hpp"
+#include "prepared.hpp"
+#include "sql.hpp"
+#include "sqlite_orm/sqlite_orm.h"
+#include <cstdint>
+#include <optional>
+#include <string>
+#include <vector>
+
+namespace service {
+/// Per bucket and per user artifact counts, content bytes and last write
+/// time. Like blob references, the counters are moved by set based
+/// statements that are expected to run inside the caller's transaction,
+/// next to the inserts and deletes of the artifacts they count.
+template <typename S> class usage {
+  S &pool;
+
+  struct counter {
+    const char *table;
+    const char *column;
+    /// what the counted artifacts are grouped by
+    const char *owner;
+  };
+
+  static constexpr counter counters[] = {
+      {"bucket_usage", "bucket_id", "artifact.bucket_id"},
+      {"user_usage", "user_id", "bucket.user_id"},
+  };
+
+  /// per owner totals of the artifacts matching `artifacts`
+  static std::string totals(const counter &counter,
+                            const std::string &artifacts) {
+    return std::string("SELECT ") + counter.owner +
+           " AS owner, count(*) AS artifacts, coalesce(sum(blob.size), 0) "
+           "AS bytes, max(artifact.updated_at) AS written FROM artifact "
+           "JOIN bucket ON bucket.id = artifact.bucket_id "
+           "LEFT JOIN blob ON blob.hash = artifact.filename WHERE " +
+           artifacts + " GROUP BY " + counter.owner;
+  }
+
+public:
+  usage(S &pool) : pool(pool) {}
+
+  /// Counts the artifacts matching `artifacts`, a condition on the artifact
+  /// table over `params` (`?1`, `?2`...), once they are inserted
+  void add_matching(const std::string &artifacts,
+                    const std::vector<std::int64_t> &params) {
+    for (const auto &counter : counters) {
+      // WHERE true keeps ON CONFLICT from parsing as a join constraint
+      execute(pool,
+              std::string("INSERT INTO ") + counter.table + " (" +
+                  counter.column +
+                  ", artifacts, bytes, last_write_at) SELECT owner, "
+                  "artifacts, bytes, written FROM (" +
+                  totals(counter, artifacts) + ") WHERE true ON CONFLICT (" +
+                  counter.column +
+                  ") DO UPDATE SET artifacts = artifacts + "
+                  "excluded.artifacts, bytes = bytes + excluded.bytes, "
+                  "last_write_at = max(last_write_at, excluded.last_write_at)",
+              params);
+    }
+  }
+
+  /// Uncounts the artifacts matching `artifacts` before they are deleted
+  void release_matching(const std::string &artifacts,
+                        std::vector<std::int64_t> params) {
+    params.push_back(util::clock::epoch());
+    const auto now =
+        "datetime(?" + std::to_string(params.size()) + ", 'unixepoch')";
+    for (const auto &counter : counters) {
+      execute(pool,
+              std::string("UPDATE ") + counter.table +
+                  " SET artifacts = " + counter.table +
+                  ".artifacts - released.artifacts, bytes = " +
+                  counter.table + ".bytes - released.bytes, last_write_at = " +
+                  now + " FROM (" + totals(counter, artifacts) +
+                  ") AS released WHERE " + counter.table + "." +
+                  counter.column + " = released.owner",
+              params);
+    }
+  }
+
+  /// Drops the counters of the buckets matching `buckets`, a condition on
+  /// the bucket table, before they are deleted
+  void forget_matching(const std::string &buckets,
+                       const std::vector<std::int64_t> &params) {
+    execute(pool,
+            "DELETE FROM bucket_usage WHERE bucket_id IN "
+            "(SELECT id FROM bucket WHERE " +
+                buckets + ")",
+            params);
+  }
+
+  /// drops the counters of the user and all their buckets
+  void forget_user(int user_id) {
+    forget_matching("bucket.user_id = ?1", {user_id});
+    execute(pool, "DELETE FROM user_usage WHERE user_id = ?1", {user_id});
+  }
+
+  /// the bucket's totals, nullopt unless `user_id` owns it
+  std::optional<model::bucket_usage> get_bucket(int bucket_id, int user_id) {
+    auto &storage = pool.get();
+    using namespace sqlite_orm;
+    auto &statement = prepared(storage, [] {
+      return select(&model::bucket::id,
+                    where(c(&model::bucket::id) == 0 and
+                          c(&model::bucket::user_id) == 0),
+                    limit(1));
+    });
+    sqlite_orm::get<0>(statement) = bucket_id;
+    sqlite_orm::get<1>(statement) = user_id;
+    if (storage.execute(statement).empty()) {
+      return {};
+    }
+    if (auto found =
+            storage.template get_pointer<model::bucket_usage>(bucket_id)) {
+      return std::move(*found);
+    }
+    return model::bucket_usage{.bucket_id = bucket_id};
+  }
+
+  model::user_usage get_user(int user_id) {
+    auto &storage = pool.get();
+    if (auto found = storage.template get_pointer<model::user_usage>(user_id)) {
+      return std::move(*found);
+    }
+    return model::user_usage{.user_id = user_id};
+  }
+};
+} // namespace service
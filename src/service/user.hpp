@@ -1,7 +1,12 @@
 #pragma once
 
+#include "../model/artifact.hpp"
 #include "../model/bucket.hpp"
 #include "../model/user.hpp"
+#include "blob.hpp"
+#include "prepared.hpp"
+#include "usage.hpp"
+#include "../util/clock.hpp"
 #include "crow/logging.h"
 #include "sqlite_orm/sqlite_orm.h"
 #include <iterator>
@@ -11,23 +16,26 @@
 
 namespace service {
 template <typename S> class user {
-  S &storage;
+  S &pool;
+  blob<S> blobs;
+  usage<S> usages;
 
 public:
-  user(S &storage) : storage(storage) {}
+  user(S &pool) : pool(pool), blobs(pool), usages(pool) {}
   int insert(model::user &user) {
-    user.created_at = user.updated_at =
-        storage.select(sqlite_orm::datetime("now", "+2 hours")).front();
+    auto &storage = pool.get();
+    user.created_at = user.updated_at = util::clock::now();
     return user.id = storage.template insert<model::user>(user);
   }
 
   void update(model::user &user) {
-    user.updated_at =
-        storage.select(sqlite_orm::datetime("now", "+2 hours")).front();
+    auto &storage = pool.get();
+    user.updated_at = util::clock::now();
     storage.template update<model::user>(user);
   }
 
   std::optional<model::user> get(int id) {
+    auto &storage = pool.get();
     try {
       return std::move(storage.template get<model::user>(id));
     } catch (std::system_error &e) {
@@ -36,6 +44,7 @@ public:
   }
 
   std::vector<model::user> get_children(model::user &user) {
+    auto &storage = pool.get();
     using namespace sqlite_orm;
     return storage.template get_all<model::user>(
         where(c(&model::user::super) == user.id));
@@ -43,12 +52,18 @@ public:
 
   std::optional<model::user> get_login(const std::string &email,
                                        const std::string &password) {
+    auto &storage = pool.get();
     using namespace sqlite_orm;
 
     try {
-      auto data = storage.template get_all<model::user>(
-          where(c(&model::user::email) == email and
-                c(&model::user::password) == password));
+      auto &statement = prepared(storage, [] {
+        return get_all<model::user>(
+            where(c(&model::user::email) == std::string{} and
+                  c(&model::user::password) == std::string{}));
+      });
+      sqlite_orm::get<0>(statement) = email;
+      sqlite_orm::get<1>(statement) = password;
+      auto data = storage.execute(statement);
       if (data.size() == 1) {
         return std::move(data.front());
       }
@@ -58,21 +73,36 @@ public:
     return {};
   }
 
-  void remove(const model::user &user) {
+  /// Removes the user with their buckets and artifacts. Returns false when
+  /// the transaction was rolled back.
+  bool remove(const model::user &user) {
+    auto &storage = pool.get();
     using namespace sqlite_orm;
-    storage.transaction([&] mutable {
+    return storage.transaction([&] mutable {
       try {
+        blobs.release_matching("artifact.bucket_id IN (SELECT id FROM bucket "
+                               "WHERE user_id = ?1)",
+                               {user.id});
+        usages.forget_user(user.id);
+        storage.template remove_all<model::artifact>(
+            where(in(&model::artifact::bucket_id,
+                     select(&model::bucket::id,
+                            where(c(&model::bucket::user_id) == user.id)))));
         storage.template remove_all<model::bucket>(
             where(c(&model::bucket::user_id) == user.id));
         storage.template remove_all<model::user>(
             where(c(&model::user::id) == user.id));
         return true;
       } catch (std::system_error &e) {
+        CROW_LOG_ERROR << __FUNCTION__ << ": " << e.what();
         return false;
       }
     });
   }
 
+  /// totals over all of the user's buckets
+  model::user_usage get_usage(int user_id) { return usages.get_user(user_id); }
+
   int add_child(const model::user &user, model::user &sub_user) {
     sub_user.super = user.id;
     update(sub_user);
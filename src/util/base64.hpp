@@ -0,0 +1,60 @@
+#pragma once
+#include <cstdint>
+#include <optional>
+#include <string>
+#include <string_view>
+
+namespace util {
+namespace base64 {
+/// base64url without padding (RFC 4648 5), safe in urls and headers
+inline std::string encode_url(std::string_view data) {
+  constexpr auto alphabet =
+      "ABCDEFGHIJKLMNOPQRSTUVWXYZabcdefghijklmnopqrstuvwxyz0123456789-_";
+  std::string result;
+  result.reserve((data.size() * 4 + 2) / 3);
+  std::uint32_t bits = 0;
+  int count = 0;
+  for (unsigned char c : data) {
+    bits = (bits << 8) | c;
+    count += 8;
+    while (count >= 6) {
+      count -= 6;
+      result += alphabet[(bits >> count) & 0x3f];
+    }
+  }
+  if (count > 0) {
+    result += alphabet[(bits << (6 - count)) & 0x3f];
+  }
+  return result;
+}
+
+inline std::optional<std::string> decode_url(std::string_view data) {
+  std::string result;
+  result.reserve(data.size() * 3 / 4);
+  std::uint32_t bits = 0;
+  int count = 0;
+  for (char c : data) {
+    int value;
+    if (c >= 'A' && c <= 'Z')
+      value = c - 'A';
+    else if (c >= 'a' && c <= 'z')
+      value = c - 'a' + 26;
+    else if (c >= '0' && c <= '9')
+      value = c - '0' + 52;
+    else if (c == '-')
+      value = 62;
+    else if (c == '_')
+      value = 63;
+    else
+      return {};
+    bits = (bits << 6) | value;
+    count += 6;
+    if (count >= 8) {
+      count -= 8;
+      result += static_cast<char>((bits >> count) & 0xff);
+    }
+  }
+  return result;
+}
+} // namespace base64
+} // namespace util
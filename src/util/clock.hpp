@@ -0,0 +1,46 @@
+#pragma once
+#include <chrono>
+#include <cstdint>
+#include <cstdio>
+#include <string>
+
+namespace util {
+namespace clock {
+/// formats `epoch` (seconds, UTC) as sqlite's datetime(): `YYYY-MM-DD HH:MM:SS`
+inline std::string format(std::int64_t epoch) {
+  using namespace std::chrono;
+  const sys_seconds time{seconds{epoch}};
+  const auto day = floor<days>(time);
+  const year_month_day date{day};
+  const hh_mm_ss clock{time - day};
+  char buffer[32];
+  std::snprintf(buffer, sizeof(buffer), "%04d-%02u-%02u %02d:%02d:%02d",
+                static_cast<int>(date.year()),
+                static_cast<unsigned>(date.month()),
+                static_cast<unsigned>(date.day()),
+                static_cast<int>(clock.hours().count()),
+                static_cast<int>(clock.minutes().count()),
+                static_cast<int>(clock.seconds().count()));
+  return buffer;
+}
+
+inline std::int64_t epoch() {
+  using namespace std::chrono;
+  return duration_cast<seconds>(system_clock::now().time_since_epoch())
+      .count();
+}
+
+/// Current UTC time as stored in the created_at/updated_at columns. The
+/// string is formatted at most once per second per thread.
+inline const std::string &now() {
+  thread_local std::int64_t cached_epoch = -1;
+  thread_local std::string cached;
+  const auto current = epoch();
+  if (current != cached_epoch) {
+    cached_epoch = current;
+    cached = format(current);
+  }
+  return cached;
+}
+} // namespace clock
+} // namespace util
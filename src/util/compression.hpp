@@ -0,0 +1,179 @@
+#pragma once
+#include <cstddef>
+#include <cstdint>
+#include <cstdlib>
+#include <stdexcept>
+#include <string>
+#include <string_view>
+#include <zlib.h>
+
+// XBUCKET_ZSTD and XBUCKET_BROTLI are defined by xmake.lua when the
+// packages resolved
+#if defined(XBUCKET_ZSTD)
+#include <zstd.h>
+#endif
+#if defined(XBUCKET_BROTLI)
+#include <brotli/encode.h>
+#endif
+
+namespace util {
+namespace compression {
+/// content codings we can produce, in the order we prefer them when a client
+/// weighs several equally
+enum class encoding { zstd, br, gzip, identity };
+
+constexpr const char *names[] = {"zstd", "br", "gzip", "identity"};
+
+inline const char *name(encoding encoding) {
+  return names[static_cast<int>(encoding)];
+}
+
+constexpr bool available(encoding encoding) {
+  switch (encoding) {
+  case encoding::zstd:
+#if defined(XBUCKET_ZSTD)
+    return true;
+#else
+    return false;
+#endif
+  case encoding::br:
+#if defined(XBUCKET_BROTLI)
+    return true;
+#else
+    return false;
+#endif
+  default:
+    return true;
+  }
+}
+
+/// how hard to try: `fast` for responses compressed per request, `best` for
+/// content compressed once and served many times
+enum class effort { fast, best };
+
+inline std::string_view trim(std::string_view str) {
+  while (!str.empty() && (str.front() == ' ' || str.front() == '\t'))
+    str.remove_prefix(1);
+  while (!str.empty() && (str.back() == ' ' || str.back() == '\t'))
+    str.remove_suffix(1);
+  return str;
+}
+
+/// Picks the coding for an `Accept-Encoding` header (RFC 9110 12.5.3): the
+/// highest weighted one we support, `*` standing for those not listed
+inline encoding negotiate(std::string_view header) {
+  double weights[4] = {-1, -1, -1, -1};
+  double wildcard = -1;
+  while (!header.empty()) {
+    auto comma = header.find(',');
+    auto item = trim(header.substr(0, comma));
+    header.remove_prefix(comma == std::string_view::npos ? header.size()
+                                                         : comma + 1);
+    auto semicolon = item.find(';');
+    auto coding = trim(item.substr(0, semicolon));
+    double weight = 1;
+    if (semicolon != std::string_view::npos) {
+      auto param = trim(item.substr(semicolon + 1));
+      if (param.substr(0, 2) == "q=" || param.substr(0, 2) == "Q=") {
+        weight = std::strtod(std::string(param.substr(2)).c_str(), nullptr);
+      }
+    }
+    if (coding == "*") {
+      wildcard = weight;
+    }
+    for (int i = 0; i < 4; i++) {
+      if (coding == names[i] || (i == 2 && coding == "x-gzip")) {
+        weights[i] = weight;
+      }
+    }
+  }
+  auto best = encoding::identity;
+  double best_weight = 0;
+  for (int i = 0; i < 3; i++) {
+    auto weight = weights[i] >= 0 ? weights[i] : wildcard;
+    if (available(static_cast<encoding>(i)) && weight > best_weight) {
+      best = static_cast<encoding>(i);
+      best_weight = weight;
+    }
+  }
+  return best;
+}
+
+inline std::string gzip(std::string_view data, effort effort) {
+  z_stream stream{};
+  if (deflateInit2(&stream, effort == effort::best ? 9 : 5, Z_DEFLATED,
+                   15 + 16, 8, Z_DEFAULT_STRATEGY) != Z_OK) {
+    throw std::runtime_error("gzip: failed to initialize");
+  }
+  std::string result(deflateBound(&stream, data.size()), '\0');
+  stream.next_in = reinterpret_cast<Bytef *>(const_cast<char *>(data.data()));
+  stream.avail_in = static_cast<uInt>(data.size());
+  stream.next_out = reinterpret_cast<Bytef *>(result.data());
+  stream.avail_out = static_cast<uInt>(result.size());
+  auto status = deflate(&stream, Z_FINISH);
+  deflateEnd(&stream);
+  if (status != Z_STREAM_END) {
+    throw std::runtime_error("gzip: failed to compress");
+  }
+  result.resize(stream.total_out);
+  return result;
+}
+
+#if defined(XBUCKET_ZSTD)
+inline std::string zstd(std::string_view data, effort effort) {
+  std::string result(ZSTD_compressBound(data.size()), '\0');
+  auto size = ZSTD_compress(result.data(), result.size(), data.data(),
+                            data.size(), effort == effort::best ? 19 : 3);
+  if (ZSTD_isError(size)) {
+    throw std::runtime_error(std::string("zstd: ") + ZSTD_getErrorName(size));
+  }
+  result.resize(size);
+  return result;
+}
+#endif
+
+#if defined(XBUCKET_BROTLI)
+inline std::string brotli(std::string_view data, effort effort) {
+  std::string result(BrotliEncoderMaxCompressedSize(data.size()), '\0');
+  auto size = result.size();
+  if (!BrotliEncoderCompress(
+          effort == effort::best ? BROTLI_MAX_QUALITY : 4, BROTLI_DEFAULT_WINDOW,
+          BROTLI_MODE_TEXT, data.size(),
+          reinterpret_cast<const uint8_t *>(data.data()), &size,
+          reinterpret_cast<uint8_t *>(result.data()))) {
+    throw std::runtime_error("brotli: failed to compress");
+  }
+  result.resize(size);
+  return result;
+}
+#endif
+
+inline std::string compress(std::string_view data, encoding encoding,
+                            effort effort) {
+  switch (encoding) {
+#if defined(XBUCKET_ZSTD)
+  case encoding::zstd:
+    return zstd(data, effort);
+#endif
+#if defined(XBUCKET_BROTLI)
+  case encoding::br:
+    return brotli(data, effort);
+#endif
+  case encoding::gzip:
+    return gzip(data, effort);
+  default:
+    return std::string(data);
+  }
+}
+
+/// media types worth compressing, everything else is assumed to be
+/// compressed already (images, archives, video)
+inline bool is_compressible(std::string_view content_type) {
+  return content_type.starts_with("text/") ||
+         content_type.starts_with("application/json") ||
+         content_type.starts_with("application/javascript") ||
+         content_type.starts_with("application/xml") ||
+         content_type.starts_with("image/svg+xml");
+}
+} // namespace compression
+} // namespace util
@@ -0,0 +1,60 @@
+#pragma once
+
+#if defined(__x86_64__) || defined(_M_X64) || defined(__i386__) ||            \
+    defined(_M_IX86)
+#define XBUCKET_X86 1
+#if defined(_MSC_VER)
+#include <intrin.h>
+#else
+#include <cpuid.h>
+#endif
+#include <immintrin.h>
+#endif
+
+/// lets a single function use instructions the translation unit was not
+/// compiled for, callers must check `util::cpu` first
+#if defined(XBUCKET_X86) && (defined(__GNUC__) || defined(__clang__))
+#define XBUCKET_TARGET(FEATURES) __attribute__((target(FEATURES)))
+#else
+#define XBUCKET_TARGET(FEATURES)
+#endif
+
+namespace util {
+namespace cpu {
+struct features {
+  bool sse42 = false;
+  bool avx2 = false;
+  bool sha = false;
+};
+
+inline features detect() {
+  features result;
+#if defined(XBUCKET_X86)
+  unsigned int regs[4] = {};
+  auto cpuid = [&regs](unsigned int leaf, unsigned int subleaf) {
+#if defined(_MSC_VER)
+    __cpuidex(reinterpret_cast<int *>(regs), leaf, subleaf);
+#else
+    __cpuid_count(leaf, subleaf, regs[0], regs[1], regs[2], regs[3]);
+#endif
+  };
+  cpuid(0, 0);
+  auto max_leaf = regs[0];
+  cpuid(1, 0);
+  result.sse42 = regs[2] & (1u << 20);
+  if (max_leaf >= 7) {
+    cpuid(7, 0);
+    result.avx2 = regs[1] & (1u << 5);
+    result.sha = regs[1] & (1u << 29);
+  }
+#endif
+  return result;
+}
+
+/// features of the running cpu, probed once
+inline const features &get() {
+  static const features detected = detect();
+  return detected;
+}
+} // namespace cpu
+} // namespace util
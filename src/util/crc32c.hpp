@@ -0,0 +1,121 @@
+#pragma once
+#include "cpu.hpp"
+#include <array>
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
+#include <string>
+#include <string_view>
+
+#if defined(__aarch64__) && defined(__ARM_FEATURE_CRC32)
+#include <arm_acle.h>
+#endif
+
+namespace util {
+/// Incremental CRC-32C (Castagnoli), the checksum used by iSCSI, ext4 and
+/// most object stores. Uses the SSE4.2 / ARMv8 crc32 instructions when the
+/// cpu has them and a slice-by-8 table otherwise.
+class crc32c {
+  using kernel = std::uint32_t (*)(std::uint32_t, const std::uint8_t *,
+                                   std::size_t);
+
+  std::uint32_t crc = 0xffffffff;
+
+  static const std::array<std::array<std::uint32_t, 256>, 8> &tables() {
+    static const auto result = [] {
+      std::array<std::array<std::uint32_t, 256>, 8> t{};
+      for (std::uint32_t i = 0; i < 256; i++) {
+        auto c = i;
+        for (int k = 0; k < 8; k++)
+          c = c & 1 ? (c >> 1) ^ 0x82f63b78 : c >> 1;
+        t[0][i] = c;
+      }
+      for (std::uint32_t i = 0; i < 256; i++)
+        for (int s = 1; s < 8; s++)
+          t[s][i] = (t[s - 1][i] >> 8) ^ t[0][t[s - 1][i] & 0xff];
+      return t;
+    }();
+    return result;
+  }
+
+  static std::uint32_t update_table(std::uint32_t crc, const std::uint8_t *data,
+                                    std::size_t size) {
+    const auto &t = tables();
+    for (; size >= 8; size -= 8, data += 8) {
+      std::uint32_t lo, hi;
+      std::memcpy(&lo, data, 4);
+      std::memcpy(&hi, data + 4, 4);
+      // the table walk assumes little endian words, as on every supported
+      // target
+      lo ^= crc;
+      crc = t[7][lo & 0xff] ^ t[6][(lo >> 8) & 0xff] ^
+            t[5][(lo >> 16) & 0xff] ^ t[4][lo >> 24] ^ t[3][hi & 0xff] ^
+            t[2][(hi >> 8) & 0xff] ^ t[1][(hi >> 16) & 0xff] ^ t[0][hi >> 24];
+    }
+    for (; size; size--, data++)
+      crc = (crc >> 8) ^ t[0][(crc ^ *data) & 0xff];
+    return crc;
+  }
+
+#if defined(XBUCKET_X86) && (defined(__x86_64__) || defined(_M_X64))
+  XBUCKET_TARGET("sse4.2")
+  static std::uint32_t update_sse42(std::uint32_t crc, const std::uint8_t *data,
+                                    std::size_t size) {
+    std::uint64_t crc64 = crc;
+    for (; size >= 8; size -= 8, data += 8) {
+      std::uint64_t word;
+      std::memcpy(&word, data, 8);
+      crc64 = _mm_crc32_u64(crc64, word);
+    }
+    crc = (std::uint32_t)crc64;
+    for (; size; size--, data++)
+      crc = _mm_crc32_u8(crc, *data);
+    return crc;
+  }
+#endif
+
+#if defined(__aarch64__) && defined(__ARM_FEATURE_CRC32)
+  static std::uint32_t update_arm(std::uint32_t crc, const std::uint8_t *data,
+                                  std::size_t size) {
+    for (; size >= 8; size -= 8, data += 8) {
+      std::uint64_t word;
+      std::memcpy(&word, data, 8);
+      crc = __crc32cd(crc, word);
+    }
+    for (; size; size--, data++)
+      crc = __crc32cb(crc, *data);
+    return crc;
+  }
+#endif
+
+  static kernel select() {
+#if defined(XBUCKET_X86) && (defined(__x86_64__) || defined(_M_X64))
+    if (cpu::get().sse42)
+      return update_sse42;
+#endif
+#if defined(__aarch64__) && defined(__ARM_FEATURE_CRC32)
+    return update_arm;
+#endif
+    return update_table;
+  }
+
+public:
+  crc32c &update(std::string_view data) {
+    static const kernel impl = select();
+    crc = impl(crc, reinterpret_cast<const std::uint8_t *>(data.data()),
+               data.size());
+    return *this;
+  }
+
+  std::uint32_t value() const { return crc ^ 0xffffffff; }
+
+  std::string hex_digest() const {
+    constexpr auto digits = "0123456789abcdef";
+    std::string result(8, '0');
+    auto v = value();
+    for (int i = 7; i >= 0; i--, v >>= 4)
+      result[i] = digits[v & 0xf];
+    return result;
+  }
+};
+} // namespace util
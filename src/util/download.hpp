@@ -0,0 +1,118 @@
+#pragma once
+#include "../constants/download.hpp"
+#include "http.hpp"
+#include <algorithm>
+#include <cerrno>
+#include <cstdint>
+#include <filesystem>
+#include <string>
+#include <system_error>
+
+#if defined(__unix__) || defined(__APPLE__)
+#include <fcntl.h>
+#include <unistd.h>
+#endif
+#if defined(__linux__)
+#include <sys/sendfile.h>
+#endif
+
+namespace util {
+namespace download {
+/// Asks the kernel to start pulling `[offset, offset + length)` of the file
+/// at `path` into the page cache, capped at constants::download::readahead_size.
+/// The advice is about the file's pages rather than our descriptor, so the
+/// reads crow makes through its own descriptor when it serves the file with
+/// set_static_file_info find them cached. POSIX_FADV_SEQUENTIAL is not
+/// given, it only widens readahead on the descriptor it is set on.
+inline void will_read(const std::string &path, std::uint64_t offset,
+                      std::uint64_t length) {
+#if defined(POSIX_FADV_WILLNEED)
+  int fd = ::open(path.c_str(), O_RDONLY | O_CLOEXEC);
+  if (fd < 0) {
+    return;
+  }
+  length = std::min<std::uint64_t>(length, constants::download::readahead_size);
+  ::posix_fadvise(fd, offset, length, POSIX_FADV_WILLNEED);
+  ::close(fd);
+#endif
+}
+
+/// Writes the bytes of `range` of the file at `path` to the file at `dest`
+/// without passing them through user space: copy_file_range, which shares
+/// extents on filesystems that reflink, or sendfile where the filesystems
+/// don't support it. Throws std::filesystem::filesystem_error.
+inline void copy_range(const std::string &path, const http::byte_range &range,
+                       const std::string &dest) {
+  int in = ::open(path.c_str(), O_RDONLY | O_CLOEXEC);
+  int out = in < 0 ? -1 : ::open(dest.c_str(), O_WRONLY | O_TRUNC | O_CLOEXEC);
+  auto fail = [&](const std::string &which) {
+    const int error = errno ? errno : EIO;
+    if (in >= 0) {
+      ::close(in);
+    }
+    if (out >= 0) {
+      ::close(out);
+    }
+    throw std::filesystem::filesystem_error(
+        "Copy of range failed", which,
+        std::error_code(error, std::generic_category()));
+  };
+  if (in < 0) {
+    fail(path);
+  }
+  if (out < 0) {
+    fail(dest);
+  }
+  std::uint64_t offset = range.first, remaining = range.size();
+#if defined(__linux__)
+  bool shared = true;
+  while (remaining) {
+    ssize_t n;
+    if (shared) {
+      loff_t from = offset;
+      n = ::copy_file_range(in, &from, out, nullptr, remaining, 0);
+      if (n < 0 && (errno == EXDEV || errno == ENOSYS || errno == EINVAL ||
+                    errno == EOPNOTSUPP)) {
+        shared = false;
+        continue;
+      }
+    } else {
+      off_t from = offset;
+      n = ::sendfile(out, in, &from, remaining);
+    }
+    if (n < 0 && errno == EINTR) {
+      continue;
+    }
+    if (n <= 0) {
+      errno = n ? errno : EIO;
+      fail(n ? path : dest);
+    }
+    offset += n;
+    remaining -= n;
+  }
+#else
+  char buffer[64 * 1024];
+  while (remaining) {
+    auto n = ::pread(in, buffer, std::min<std::uint64_t>(remaining,
+                                                         sizeof(buffer)),
+                     offset);
+    if (n < 0 && errno == EINTR) {
+      continue;
+    }
+    if (n <= 0 || ::write(out, buffer, n) != n) {
+      errno = n ? errno : EIO;
+      fail(dest);
+    }
+    offset += n;
+    remaining -= n;
+  }
+#endif
+  ::close(in);
+  if (::close(out) != 0) {
+    out = -1;
+    in = -1;
+    fail(dest);
+  }
+}
+} // namespace download
+} // namespace util
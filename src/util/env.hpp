@@ -0,0 +1,29 @@
+#pragma once
+#include <cstdlib>
+#include <sstream>
+#include <stdexcept>
+#include <string>
+#include <type_traits>
+
+namespace util {
+namespace env {
+/// reads an environment variable, `default_value` when unset or empty
+template <typename T> T get_or(const std::string &name, T default_value) {
+  const char *value = std::getenv(name.c_str());
+  if (value == nullptr || *value == '\0') {
+    return default_value;
+  }
+  if constexpr (std::is_same_v<T, std::string>) {
+    return value;
+  } else {
+    std::istringstream stream(value);
+    T result;
+    if (!(stream >> std::boolalpha >> result)) {
+      throw std::runtime_error("invalid value for environment variable " +
+                               name);
+    }
+    return result;
+  }
+}
+} // namespace env
+} // namespace util
@@ -0,0 +1,47 @@
+#pragma once
+#include "sha256.hpp"
+#include <cstddef>
+#include <cstdint>
+#include <string>
+#include <string_view>
+
+namespace util {
+/// HMAC-SHA256 (RFC 2104) of `message` under `key`
+inline sha256::digest_type hmac_sha256(std::string_view key,
+                                       std::string_view message) {
+  constexpr std::size_t block_size = 64;
+  std::string block(block_size, '\0');
+  if (key.size() > block_size) {
+    auto digest = sha256{}.update(key).digest();
+    block.replace(0, digest.size(),
+                  reinterpret_cast<const char *>(digest.data()),
+                  digest.size());
+  } else {
+    block.replace(0, key.size(), key);
+  }
+  std::string inner(block), outer(block);
+  for (std::size_t i = 0; i < block_size; i++) {
+    inner[i] ^= 0x36;
+    outer[i] ^= 0x5c;
+  }
+  auto inner_digest = sha256{}.update(inner).update(message).digest();
+  return sha256{}
+      .update(outer)
+      .update(std::string_view(reinterpret_cast<const char *>(inner_digest.data()),
+                               inner_digest.size()))
+      .digest();
+}
+
+/// compares without an early exit, so the time taken does not tell how much
+/// of a signature was right
+inline bool constant_time_equal(std::string_view a, std::string_view b) {
+  if (a.size() != b.size()) {
+    return false;
+  }
+  unsigned char difference = 0;
+  for (std::size_t i = 0; i < a.size(); i++) {
+    difference |= static_cast<unsigned char>(a[i] ^ b[i]);
+  }
+  return difference == 0;
+}
+} // namespace util
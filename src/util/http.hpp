@@ -0,0 +1,187 @@
+#pragma once
+#include "../constants/download.hpp"
+#include <algorithm>
+#include <cstdint>
+#include <cstdio>
+#include <ctime>
+#include <optional>
+#include <string>
+#include <string_view>
+#include <vector>
+
+namespace util {
+namespace http {
+
+/// inclusive byte range, as written in Range / Content-Range
+struct byte_range {
+  std::uint64_t first;
+  std::uint64_t last;
+
+  std::uint64_t size() const { return last - first + 1; }
+};
+
+struct range_request {
+  enum class status { none, satisfiable, unsatisfiable } result;
+  std::vector<byte_range> ranges;
+};
+
+inline std::string_view trim(std::string_view str) {
+  while (!str.empty() && (str.front() == ' ' || str.front() == '\t'))
+    str.remove_prefix(1);
+  while (!str.empty() && (str.back() == ' ' || str.back() == '\t'))
+    str.remove_suffix(1);
+  return str;
+}
+
+inline std::optional<std::uint64_t> parse_uint(std::string_view str) {
+  if (str.empty() || str.size() > 19)
+    return {};
+  std::uint64_t value = 0;
+  for (auto c : str) {
+    if (c < '0' || c > '9')
+      return {};
+    value = value * 10 + (c - '0');
+  }
+  return value;
+}
+
+/// Parses a `Range: bytes=...` header against a representation of `size`
+/// bytes (RFC 9110 14.2). Anything that is not a valid bytes range set is
+/// ignored as the RFC allows, and so is a set of more than
+/// constants::download::max_ranges ranges. Overlapping and adjacent ranges
+/// are coalesced, the result is in ascending order.
+inline range_request parse_range(std::string_view header, std::uint64_t size) {
+  range_request request{range_request::status::none, {}};
+  header = trim(header);
+  if (header.substr(0, 6) != "bytes=")
+    return request;
+  header.remove_prefix(6);
+  std::size_t specs = 0;
+  while (!header.empty()) {
+    auto comma = header.find(',');
+    auto spec = trim(header.substr(0, comma));
+    header.remove_prefix(comma == std::string_view::npos ? header.size()
+                                                         : comma + 1);
+    if (spec.empty())
+      continue;
+    if (++specs > constants::download::max_ranges)
+      return {range_request::status::none, {}};
+    auto dash = spec.find('-');
+    if (dash == std::string_view::npos)
+      return {range_request::status::none, {}};
+    auto first = trim(spec.substr(0, dash)), last = trim(spec.substr(dash + 1));
+    if (first.empty()) {
+      // suffix range: the last N bytes
+      auto suffix = parse_uint(last);
+      if (!suffix)
+        return {range_request::status::none, {}};
+      if (*suffix && size)
+        request.ranges.push_back(
+            {size - std::min(*suffix, size), size - 1});
+      continue;
+    }
+    auto from = parse_uint(first);
+    auto to = last.empty() ? std::optional<std::uint64_t>{UINT64_MAX}
+                           : parse_uint(last);
+    if (!from || !to || *to < *from)
+      return {range_request::status::none, {}};
+    if (*from < size)
+      request.ranges.push_back({*from, std::min(*to, size - 1)});
+  }
+  std::sort(request.ranges.begin(), request.ranges.end(),
+            [](const byte_range &a, const byte_range &b) {
+              return a.first < b.first;
+            });
+  std::vector<byte_range> coalesced;
+  for (const auto &range : request.ranges) {
+    if (!coalesced.empty() && range.first <= coalesced.back().last + 1)
+      coalesced.back().last = std::max(coalesced.back().last, range.last);
+    else
+      coalesced.push_back(range);
+  }
+  request.ranges = std::move(coalesced);
+  request.result = request.ranges.empty()
+                       ? range_request::status::unsatisfiable
+                       : range_request::status::satisfiable;
+  return request;
+}
+
+/// days since 1970-01-01 of a proleptic gregorian date
+constexpr std::int64_t days_from_civil(std::int64_t y, unsigned m, unsigned d) {
+  y -= m <= 2;
+  const auto era = (y >= 0 ? y : y - 399) / 400;
+  const auto yoe = static_cast<unsigned>(y - era * 400);
+  const auto doy = (153 * (m + (m > 2 ? -3 : 9)) + 2) / 5 + d - 1;
+  const auto doe = yoe * 365 + yoe / 4 - yoe / 100 + doy;
+  return era * 146097 + static_cast<std::int64_t>(doe) - 719468;
+}
+
+/// parses `YYYY-MM-DD HH:MM:SS` as written by sqlite's datetime()
+inline std::optional<std::int64_t> parse_sql_datetime(const std::string &str) {
+  int y, mo, d, h, mi, s;
+  if (std::sscanf(str.c_str(), "%d-%d-%d %d:%d:%d", &y, &mo, &d, &h, &mi,
+                  &s) != 6)
+    return {};
+  return days_from_civil(y, mo, d) * 86400 + h * 3600 + mi * 60 + s;
+}
+
+constexpr const char *week_days[] = {"Sun", "Mon", "Tue", "Wed",
+                                     "Thu", "Fri", "Sat"};
+constexpr const char *months[] = {"Jan", "Feb", "Mar", "Apr", "May", "Jun",
+                                  "Jul", "Aug", "Sep", "Oct", "Nov", "Dec"};
+
+/// formats an IMF-fixdate, e.g. `Sun, 06 Nov 1994 08:49:37 GMT`
+inline std::string format_date(std::int64_t epoch) {
+  auto days = epoch >= 0 ? epoch / 86400 : (epoch - 86399) / 86400;
+  auto secs = epoch - days * 86400;
+  // civil_from_days
+  auto z = days + 719468;
+  auto era = (z >= 0 ? z : z - 146096) / 146097;
+  auto doe = static_cast<unsigned>(z - era * 146097);
+  auto yoe = (doe - doe / 1460 + doe / 36524 - doe / 146096) / 365;
+  auto doy = doe - (365 * yoe + yoe / 4 - yoe / 100);
+  auto mp = (5 * doy + 2) / 153;
+  unsigned d = doy - (153 * mp + 2) / 5 + 1;
+  unsigned m = mp < 10 ? mp + 3 : mp - 9;
+  auto y = static_cast<std::int64_t>(yoe) + era * 400 + (m <= 2);
+  char buffer[64];
+  std::snprintf(buffer, sizeof(buffer), "%s, %02u %s %04lld %02d:%02d:%02d GMT",
+                week_days[((days % 7) + 11) % 7], d, months[m - 1],
+                static_cast<long long>(y), static_cast<int>(secs / 3600),
+                static_cast<int>(secs / 60 % 60), static_cast<int>(secs % 60));
+  return buffer;
+}
+
+/// parses an IMF-fixdate, the only format senders are allowed to generate
+inline std::optional<std::int64_t> parse_date(const std::string &str) {
+  char week_day[4], month[4];
+  int d, y, h, mi, s;
+  if (std::sscanf(str.c_str(), "%3s, %d %3s %d %d:%d:%d GMT", week_day, &d,
+                  month, &y, &h, &mi, &s) != 7)
+    return {};
+  for (unsigned m = 0; m < 12; m++) {
+    if (std::string_view(months[m]) == month)
+      return days_from_civil(y, m + 1, d) * 86400 + h * 3600 + mi * 60 + s;
+  }
+  return {};
+}
+
+/// If-None-Match uses the weak comparison, so `W/` prefixes are ignored
+inline bool etag_list_matches(std::string_view header, std::string_view etag) {
+  header = trim(header);
+  if (header == "*")
+    return true;
+  auto strip = [](std::string_view tag) {
+    return tag.substr(0, 2) == "W/" ? tag.substr(2) : tag;
+  };
+  while (!header.empty()) {
+    auto comma = header.find(',');
+    if (strip(trim(header.substr(0, comma))) == strip(etag))
+      return true;
+    header.remove_prefix(comma == std::string_view::npos ? header.size()
+                                                         : comma + 1);
+  }
+  return false;
+}
+} // namespace http
+} // namespace util
@@ -0,0 +1,425 @@
+#pragma once
+#include "../constants/image.hpp"
+#include <algorithm>
+#include <cctype>
+#include <cmath>
+#include <cstdlib>
+#include <array>
+#include <cstdint>
+#include <filesystem>
+#include <fstream>
+#include <optional>
+#include <opencv2/core.hpp>
+#include <opencv2/imgcodecs.hpp>
+#include <opencv2/imgproc.hpp>
+#include <stdexcept>
+#include <string>
+#include <string_view>
+#include <vector>
+
+namespace util {
+namespace image {
+/// an image that would decode to more than constants::image allows
+struct too_large : std::runtime_error {
+  using std::runtime_error::runtime_error;
+};
+
+struct dimensions {
+  std::int64_t width;
+  std::int64_t height;
+};
+
+/// Width and height from the header of a png, jpeg, webp, gif or bmp file,
+/// without decoding it. nullopt for other or truncated files.
+inline std::optional<dimensions> read_dimensions(const std::string &path) {
+  std::ifstream file(path, std::ios::binary);
+  std::array<unsigned char, 32> head{};
+  file.read(reinterpret_cast<char *>(head.data()), head.size());
+  const auto got = static_cast<std::size_t>(file.gcount());
+  if (got < 12) {
+    return {};
+  }
+  auto be16 = [&head](int at) { return head[at] << 8 | head[at + 1]; };
+  auto le16 = [&head](int at) { return head[at] | head[at + 1] << 8; };
+  auto le24 = [&head](int at) {
+    return head[at] | head[at + 1] << 8 | head[at + 2] << 16;
+  };
+  auto be32 = [&](int at) {
+    return std::int64_t(be16(at)) << 16 | be16(at + 2);
+  };
+  auto le32 = [&](int at) {
+    return std::int64_t(std::int32_t(le16(at) | le16(at + 2) << 16));
+  };
+  const std::string_view magic(reinterpret_cast<char *>(head.data()), got);
+  if (magic.starts_with("\x89PNG\r\n\x1a\n") && got >= 24) {
+    return dimensions{be32(16), be32(20)};
+  }
+  if (magic.starts_with("GIF8")) {
+    return dimensions{le16(6), le16(8)};
+  }
+  if (magic.starts_with("BM") && got >= 26) {
+    return dimensions{std::abs(le32(18)), std::abs(le32(22))};
+  }
+  if (magic.starts_with("RIFF") && magic.substr(8, 4) == "WEBP" && got >= 30) {
+    auto chunk = magic.substr(12, 4);
+    if (chunk == "VP8 ") {
+      return dimensions{le16(26) & 0x3fff, le16(28) & 0x3fff};
+    }
+    if (chunk == "VP8L") {
+      return dimensions{1 + (le16(21) & 0x3fff),
+                        1 + (le24(22) >> 6 & 0x3fff)};
+    }
+    if (chunk == "VP8X") {
+      return dimensions{1 + le24(24), 1 + le24(27)};
+    }
+    return {};
+  }
+  if (!magic.starts_with("\xff\xd8")) {
+    return {};
+  }
+  // walk the jpeg segments up to the frame header
+  file.clear();
+  file.seekg(2);
+  unsigned char marker[4];
+  while (file.read(reinterpret_cast<char *>(marker), 2) &&
+         marker[0] == 0xff) {
+    if (marker[1] == 0xff) {
+      file.seekg(-1, std::ios::cur);
+      continue;
+    }
+    if (marker[1] == 0x01 || (marker[1] >= 0xd0 && marker[1] <= 0xd9)) {
+      continue;
+    }
+    if (!file.read(reinterpret_cast<char *>(marker + 2), 2)) {
+      return {};
+    }
+    const auto length = marker[2] << 8 | marker[3];
+    const auto frame = marker[1] >= 0xc0 && marker[1] <= 0xcf &&
+                       marker[1] != 0xc4 && marker[1] != 0xc8 &&
+                       marker[1] != 0xcc;
+    if (frame) {
+      unsigned char sof[5];
+      if (!file.read(reinterpret_cast<char *>(sof), 5)) {
+        return {};
+      }
+      return dimensions{sof[3] << 8 | sof[4], sof[1] << 8 | sof[2]};
+    }
+    if (length < 2) {
+      return {};
+    }
+    file.seekg(length - 2, std::ios::cur);
+  }
+  return {};
+}
+
+/// Throws too_large for sources over constants::image::max_source_size or
+/// max_pixels. Formats whose header we don't read are left to OpenCV's own
+/// pixel limit, see limit_decoder.
+inline void check_source(const std::string &path) {
+  std::error_code error;
+  auto size = std::filesystem::file_size(path, error);
+  if (error) {
+    throw std::runtime_error("image not found");
+  }
+  if (size > constants::image::max_source_size) {
+    throw too_large("image too large to transform");
+  }
+  if (auto found = read_dimensions(path);
+      found && found->width * found->height > constants::image::max_pixels) {
+    throw too_large("image has more than " +
+                    std::to_string(constants::image::max_pixels) + " pixels");
+  }
+}
+
+/// whether the file at `path` starts with the jpeg SOI marker
+inline bool is_jpeg(const std::string &path) {
+  std::ifstream file(path, std::ios::binary);
+  char head[3] = {};
+  return file.read(head, sizeof(head)) &&
+         std::string_view(head, sizeof(head)) == "\xff\xd8\xff";
+}
+
+/// Caps what OpenCV itself decodes at max_pixels, for the formats
+/// read_dimensions doesn't know. Call before the first decode, OpenCV reads
+/// the setting once; an explicit OPENCV_IO_MAX_IMAGE_PIXELS is kept.
+inline void limit_decoder() {
+  ::setenv("OPENCV_IO_MAX_IMAGE_PIXELS",
+           std::to_string(constants::image::max_pixels).c_str(), 0);
+}
+/// output format of a file name's extension, empty when it is not an image
+/// format we encode
+inline std::string format_of(const std::string &filename) {
+  auto dot = filename.rfind('.');
+  if (dot == std::string::npos) {
+    return "";
+  }
+  std::string extension = filename.substr(dot + 1);
+  std::transform(extension.begin(), extension.end(), extension.begin(),
+                 [](unsigned char c) { return std::tolower(c); });
+  if (extension == "jpg" || extension == "jpeg") {
+    return "jpeg";
+  }
+  if (extension == "png" || extension == "webp") {
+    return extension;
+  }
+  return "";
+}
+
+inline std::string content_type(const std::string &format) {
+  return "image/" + format;
+}
+
+/// Derivative asked for with the `width`, `height`, `fit`, `format` and
+/// `quality` path params. A missing dimension follows the aspect ratio.
+///  - contain: fit inside width x height
+///  - cover: fill width x height, cropping the overflow around the center
+///  - fill: stretch to width x height
+struct transform {
+  int width = 0;
+  int height = 0;
+  std::string fit = "contain";
+  /// `jpeg`, `png` or `webp`, empty keeps the source format
+  std::string format;
+  int quality = constants::image::default_quality;
+
+  /// the transform named in constants::image::renditions
+  static std::optional<transform> rendition(std::string_view name) {
+    if (name == "thumb") {
+      return transform{.width = 256, .height = 256, .fit = "cover"};
+    }
+    if (name == "medium") {
+      return transform{.width = 1024, .height = 1024};
+    }
+    if (name == "webp") {
+      return transform{.format = "webp"};
+    }
+    return {};
+  }
+
+  /// nullopt when the request asks for no transform at all, a `rendition`
+  /// param takes precedence over the individual ones
+  template <typename Request>
+  static std::optional<transform> from_request(const Request &req) {
+    auto param = [&req](const char *name) -> std::optional<std::string> {
+      if (const char *value = req.url_params.get(name)) {
+        return std::string(value);
+      }
+      return {};
+    };
+    auto number = [](const std::string &name, const std::string &value,
+                     int min, int max) {
+      char *end = nullptr;
+      auto result = std::strtol(value.c_str(), &end, 10);
+      if (value.empty() || *end != '\0' || result < min || result > max) {
+        throw std::runtime_error(name + " must be between " +
+                                 std::to_string(min) + " and " +
+                                 std::to_string(max));
+      }
+      return static_cast<int>(result);
+    };
+    if (auto name = param("rendition")) {
+      if (auto named = rendition(*name)) {
+        return named;
+      }
+      throw std::runtime_error("unknown rendition: " + *name);
+    }
+    auto width = param("width"), height = param("height"), fit = param("fit"),
+         format = param("format"), quality = param("quality");
+    if (!width && !height && !fit && !format && !quality) {
+      return {};
+    }
+    transform result;
+    if (width) {
+      result.width =
+          number("width", *width, 1, constants::image::max_dimension);
+    }
+    if (height) {
+      result.height =
+          number("height", *height, 1, constants::image::max_dimension);
+    }
+    if (fit) {
+      if (*fit != "contain" && *fit != "cover" && *fit != "fill") {
+        throw std::runtime_error("fit must be contain, cover or fill");
+      }
+      result.fit = *fit;
+    }
+    if (format) {
+      result.format = format_of("." + *format);
+      if (result.format.empty()) {
+        throw std::runtime_error("format must be jpeg, png or webp");
+      }
+    }
+    if (quality) {
+      result.quality = number("quality", *quality, 1, 100);
+    }
+    return result;
+  }
+
+  /// Canonical spelling of the transform once the source format is known,
+  /// equal for requests that produce the same bytes
+  std::string key() const {
+    auto result = std::to_string(width) + "x" + std::to_string(height);
+    if (width && height) {
+      result += "-" + fit;
+    }
+    result += "-" + format;
+    // png is lossless, quality does not change its output
+    if (format != "png") {
+      result += "-q" + std::to_string(quality);
+    }
+    return result;
+  }
+};
+
+/// Output size of `transform` on a `source` sized image. A side the fit
+/// derives from the aspect ratio is kept within max_dimension by scaling
+/// both down, so a 1x10000 source at width=4096 gives 1x4096. Throws
+/// too_large for outputs over max_pixels.
+inline cv::Size target_size(cv::Size source, const transform &transform) {
+  const double sw = source.width, sh = source.height;
+  const double limit = constants::image::max_dimension;
+  double width = transform.width, height = transform.height;
+  // cover crops to the requested aspect ratio and fill stretches to it,
+  // both come out at exactly width x height
+  if (!width || !height || transform.fit == "contain") {
+    double scale = std::min(width ? width / sw : height / sh,
+                            height ? height / sh : width / sw);
+    scale = std::min({scale, limit / sw, limit / sh});
+    width = sw * scale;
+    height = sh * scale;
+  }
+  auto side = [limit](double value) {
+    return static_cast<int>(std::clamp(std::round(value), 1.0, limit));
+  };
+  cv::Size size(side(width), side(height));
+  if (std::int64_t(size.width) * size.height > constants::image::max_pixels) {
+    throw too_large("output has more than " +
+                    std::to_string(constants::image::max_pixels) + " pixels");
+  }
+  return size;
+}
+
+/// the centered region of a `source` sized image with the aspect ratio of
+/// `target`, what `cover` keeps before scaling
+inline cv::Rect cover_crop(cv::Size source, cv::Size target) {
+  const double ratio = double(target.width) / target.height;
+  int width = source.width, height = source.height;
+  if (width > height * ratio) {
+    width = std::max(1, static_cast<int>(std::lround(height * ratio)));
+  } else {
+    height = std::max(1, static_cast<int>(std::lround(width / ratio)));
+  }
+  return cv::Rect((source.width - width) / 2, (source.height - height) / 2,
+                  width, height);
+}
+
+/// the scaled (and for `cover` cropped) image for `transform`
+inline cv::Mat resize(const cv::Mat &source, const transform &transform) {
+  if (!transform.width && !transform.height) {
+    return source;
+  }
+  auto size = target_size(source.size(), transform);
+  cv::Mat region = source;
+  if (transform.fit == "cover" && transform.width && transform.height) {
+    region = source(cover_crop(source.size(), size));
+  }
+  cv::Mat result;
+  // area averaging avoids moire when shrinking, cubic looks best enlarging
+  cv::resize(region, result, size, 0, 0,
+             size.width < region.cols && size.height < region.rows
+                 ? cv::INTER_AREA
+                 : cv::INTER_CUBIC);
+  return result;
+}
+
+inline std::vector<int> encode_params(const transform &transform) {
+  if (transform.format == "jpeg") {
+    return {cv::IMWRITE_JPEG_QUALITY, transform.quality,
+            cv::IMWRITE_JPEG_OPTIMIZE, 1};
+  }
+  if (transform.format == "webp") {
+    return {cv::IMWRITE_WEBP_QUALITY, transform.quality};
+  }
+  return {cv::IMWRITE_PNG_COMPRESSION, 6};
+}
+
+/// Decodes the image at `path`, applies `transform` (its format must be
+/// set) and returns the encoded result
+inline std::string apply(const std::string &path, const transform &transform) {
+  check_source(path);
+  // jpeg sources are decoded to 8 bit BGR, which applies their exif
+  // orientation whatever the output format; so are sources encoded to
+  // jpeg, it has no alpha channel. Others keep their channels and depth.
+  auto source = cv::imread(path, is_jpeg(path) || transform.format == "jpeg"
+                                     ? cv::IMREAD_COLOR
+                                     : cv::IMREAD_UNCHANGED);
+  if (source.empty()) {
+    throw std::runtime_error("artifact is not a decodable image");
+  }
+  if (source.depth() == CV_16U) {
+    source.convertTo(source, CV_8U, 1.0 / 257);
+  } else if (source.depth() != CV_8U) {
+    source.convertTo(source, CV_8U);
+  }
+  auto result = resize(source, transform);
+  std::vector<uchar> buffer;
+  if (!cv::imencode("." + transform.format, result, buffer,
+                    encode_params(transform))) {
+    throw std::runtime_error("failed to encode " + transform.format);
+  }
+  return std::string(buffer.begin(), buffer.end());
+}
+struct recompressed {
+  std::string data;
+  std::string format;
+};
+
+/// Re-encodes the `format` image at `path` under a bucket compression policy
+///  - lossless: png at the highest zlib level, jpeg is left alone
+///  - lossy: also jpeg at `quality` with optimized huffman tables
+///  - webp: jpeg and png converted to webp at `quality`
+/// nullopt when the policy does not apply or the result isn't smaller,
+/// throws too_large for sources over max_pixels.
+/// Metadata (exif, icc profiles) is not carried over, jpeg orientation is
+/// applied to the pixels instead.
+inline std::optional<recompressed> recompress(const std::string &path,
+                                              const std::string &format,
+                                              const std::string &policy,
+                                              int quality) {
+  if ((format != "jpeg" && format != "png") ||
+      (policy == "lossless" && format != "png")) {
+    return {};
+  }
+  std::error_code error;
+  auto size = std::filesystem::file_size(path, error);
+  if (error || size > constants::image::max_source_size) {
+    return {};
+  }
+  check_source(path);
+  auto source = cv::imread(path, format == "jpeg" ? cv::IMREAD_COLOR
+                                                  : cv::IMREAD_UNCHANGED);
+  if (source.empty()) {
+    return {};
+  }
+  recompressed result{.format = policy == "webp" ? "webp" : format};
+  std::vector<int> params;
+  if (result.format == "png") {
+    params = {cv::IMWRITE_PNG_COMPRESSION, 9};
+  } else if (result.format == "jpeg") {
+    params = {cv::IMWRITE_JPEG_QUALITY, quality, cv::IMWRITE_JPEG_OPTIMIZE, 1};
+  } else {
+    if (source.depth() != CV_8U) {
+      source.convertTo(source, CV_8U, source.depth() == CV_16U ? 1.0 / 257 : 1);
+    }
+    params = {cv::IMWRITE_WEBP_QUALITY, quality};
+  }
+  std::vector<uchar> buffer;
+  if (!cv::imencode("." + result.format, source, buffer, params) ||
+      buffer.size() >= size) {
+    return {};
+  }
+  result.data.assign(buffer.begin(), buffer.end());
+  return result;
+}
+} // namespace image
+} // namespace util
@@ -1,5 +1,7 @@
 #pragma once
 #include <crow/json.h>
+#include <optional>
+#include <string>
 
 namespace util {
    namespace json {
@@ -16,5 +18,25 @@ namespace util {
        T get_or(const crow::json::rvalue & body ,const std::string & field, T default_value) {
              return body.has(field) ? (T)body[field] : default_value;
        }
+
+       /// Writes `{"items":[...],"next":cursor}` from each item's `to_json()`,
+       /// one item at a time, so no tree is ever built for the whole page.
+       /// `next` is null on the last page.
+       template <typename Items>
+       std::string page(const Items & items, std::optional<int> next) {
+             std::string result = "{\"items\":[";
+             bool first = true;
+             for (const auto & item : items) {
+                 if (!first) {
+                     result += ',';
+                 }
+                 first = false;
+                 result += item.to_json().dump();
+             }
+             result += "],\"next\":";
+             result += next ? std::to_string(*next) : "null";
+             result += '}';
+             return result;
+       }
    }
 }
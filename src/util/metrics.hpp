@@ -0,0 +1,242 @@
+#pragma once
+#include <algorithm>
+#include <array>
+#include <atomic>
+#include <bit>
+#include <cstddef>
+#include <cstdint>
+#include <functional>
+#include <map>
+#include <mutex>
+#include <string>
+#include <string_view>
+#include <vector>
+
+namespace util {
+namespace metrics {
+class counter {
+  std::atomic<std::uint64_t> value{0};
+
+public:
+  void add(std::uint64_t amount = 1) {
+    value.fetch_add(amount, std::memory_order_relaxed);
+  }
+  std::uint64_t get() const { return value.load(std::memory_order_relaxed); }
+};
+
+class gauge {
+  std::atomic<std::int64_t> value{0};
+
+public:
+  /// adds `amount` for as long as it lives
+  class hold {
+    gauge &target;
+    std::int64_t amount;
+
+  public:
+    hold(gauge &target, std::int64_t amount) : target(target), amount(amount) {
+      target.add(amount);
+    }
+    ~hold() { target.add(-amount); }
+    hold(const hold &) = delete;
+    hold &operator=(const hold &) = delete;
+  };
+
+  void add(std::int64_t amount) {
+    value.fetch_add(amount, std::memory_order_relaxed);
+  }
+  std::int64_t get() const { return value.load(std::memory_order_relaxed); }
+};
+
+/// Log-linear histogram of microseconds in the spirit of HDR histograms:
+/// every power of two is split into `sub_buckets` equal buckets, so a bucket
+/// is never wider than a quarter of its values, from 1us up to ~70 minutes.
+/// Recording is two relaxed increments and an add.
+class histogram {
+public:
+  static constexpr int sub_bits = 2;
+  static constexpr std::size_t sub_buckets = 1 << sub_bits;
+  static constexpr std::size_t size = 32 * sub_buckets;
+
+  static constexpr std::size_t index(std::uint64_t value) {
+    if (value < sub_buckets) {
+      return value;
+    }
+    auto exponent = std::bit_width(value) - 1;
+    auto sub = (value >> (exponent - sub_bits)) & (sub_buckets - 1);
+    return std::min<std::size_t>(
+        (exponent - sub_bits + 1) * sub_buckets + sub, size - 1);
+  }
+
+  /// exclusive upper bound of bucket `i`
+  static constexpr std::uint64_t upper_bound(std::size_t i) {
+    if (i < sub_buckets) {
+      return i + 1;
+    }
+    auto exponent = i / sub_buckets + sub_bits - 1;
+    auto sub = i % sub_buckets;
+    return (sub_buckets + sub + 1) << (exponent - sub_bits);
+  }
+
+  void record(std::uint64_t micros) {
+    buckets[index(micros)].fetch_add(1, std::memory_order_relaxed);
+    count.fetch_add(1, std::memory_order_relaxed);
+    sum.fetch_add(micros, std::memory_order_relaxed);
+  }
+
+  std::array<std::atomic<std::uint64_t>, size> buckets{};
+  std::atomic<std::uint64_t> count{0};
+  std::atomic<std::uint64_t> sum{0};
+};
+
+/// what is known about one registered route
+struct route {
+  std::string method;
+  std::string path;
+  histogram latency;
+  /// responses by status class, 1xx to 5xx
+  std::array<counter, 5> responses;
+};
+
+/// Process wide metrics. Routes are added while the server starts and
+/// never after, so request threads look them up without locking.
+class registry {
+  std::mutex mutex;
+  std::map<std::string, std::map<int, route>, std::less<>> routes;
+  struct observed_gauge {
+    std::string name;
+    std::string help;
+    std::function<double()> read;
+  };
+  std::vector<observed_gauge> observed;
+
+  static void write_histogram(std::string &out, std::string_view name,
+                              const std::string &labels,
+                              const histogram &histogram) {
+    auto prefix = labels.empty() ? "{" : "{" + labels + ",";
+    std::uint64_t cumulative = 0;
+    for (std::size_t i = 0; i + 1 < histogram::size; i++) {
+      cumulative += histogram.buckets[i].load(std::memory_order_relaxed);
+      // finer buckets than 16us add lines without telling much
+      if (histogram::upper_bound(i) < 16) {
+        continue;
+      }
+      out += name;
+      out += "_bucket";
+      out += prefix;
+      out += "le=\"";
+      out += std::to_string(histogram::upper_bound(i) / 1e6);
+      out += "\"} ";
+      out += std::to_string(cumulative);
+      out += '\n';
+    }
+    auto count = histogram.count.load(std::memory_order_relaxed);
+    out += name;
+    out += "_bucket";
+    out += prefix;
+    out += "le=\"+Inf\"} " + std::to_string(count) + '\n';
+    out += name;
+    out += "_sum";
+    out += labels.empty() ? "" : "{" + labels + "}";
+    out += ' ' +
+           std::to_string(histogram.sum.load(std::memory_order_relaxed) / 1e6) +
+           '\n';
+    out += name;
+    out += "_count";
+    out += labels.empty() ? "" : "{" + labels + "}";
+    out += ' ' + std::to_string(count) + '\n';
+  }
+
+  static void write_header(std::string &out, std::string_view name,
+                           std::string_view type, std::string_view help) {
+    out += "# HELP ";
+    out += name;
+    out += ' ';
+    out += help;
+    out += "\n# TYPE ";
+    out += name;
+    out += ' ';
+    out += type;
+    out += '\n';
+  }
+
+public:
+  /// bytes of upload bodies being processed
+  gauge uploading;
+  /// time sqlite spends running each statement
+  histogram statements;
+
+  static registry &instance() {
+    static registry registry;
+    return registry;
+  }
+
+  route &add_route(const std::string &path, int method,
+                   const std::string &method_name) {
+    std::lock_guard lock(mutex);
+    auto &found = routes[path][method];
+    found.method = method_name;
+    found.path = path;
+    return found;
+  }
+
+  route *find_route(std::string_view path, int method) {
+    auto by_path = routes.find(path);
+    if (by_path == routes.end()) {
+      return nullptr;
+    }
+    auto by_method = by_path->second.find(method);
+    return by_method == by_path->second.end() ? nullptr : &by_method->second;
+  }
+
+  /// a gauge read when scraped, for values kept elsewhere
+  void observe(std::string name, std::string help,
+               std::function<double()> read) {
+    std::lock_guard lock(mutex);
+    observed.push_back({std::move(name), std::move(help), std::move(read)});
+  }
+
+  /// the Prometheus text exposition format, version 0.0.4
+  std::string render() {
+    std::string out;
+    out.reserve(64 * 1024);
+    write_header(out, "xbucket_http_requests_total", "counter",
+                 "Responses by route and status class");
+    for (auto &[path, methods] : routes) {
+      for (auto &[method, route] : methods) {
+        for (std::size_t i = 0; i < route.responses.size(); i++) {
+          out += "xbucket_http_requests_total{method=\"" + route.method +
+                 "\",route=\"" + route.path + "\",code=\"" +
+                 std::to_string(i + 1) + "xx\"} " +
+                 std::to_string(route.responses[i].get()) + '\n';
+        }
+      }
+    }
+    write_header(out, "xbucket_http_request_duration_seconds", "histogram",
+                 "Time from routing a request to finishing its response");
+    for (auto &[path, methods] : routes) {
+      for (auto &[method, route] : methods) {
+        write_histogram(out, "xbucket_http_request_duration_seconds",
+                        "method=\"" + route.method + "\",route=\"" +
+                            route.path + "\"",
+                        route.latency);
+      }
+    }
+    write_header(out, "xbucket_sql_statement_duration_seconds", "histogram",
+                 "Time SQLite spends running a statement");
+    write_histogram(out, "xbucket_sql_statement_duration_seconds", "",
+                    statements);
+    write_header(out, "xbucket_upload_bytes_in_flight", "gauge",
+                 "Bytes of upload bodies being stored");
+    out += "xbucket_upload_bytes_in_flight " +
+           std::to_string(uploading.get()) + '\n';
+    std::lock_guard lock(mutex);
+    for (auto &gauge : observed) {
+      write_header(out, gauge.name, "gauge", gauge.help);
+      out += gauge.name + ' ' + std::to_string(gauge.read()) + '\n';
+    }
+    return out;
+  }
+};
+} // namespace metrics
+} // namespace util
@@ -0,0 +1,216 @@
+#pragma once
+#include "../constants/upload.hpp"
+#include <algorithm>
+#include <cctype>
+#include <cstddef>
+#include <functional>
+#include <map>
+#include <stdexcept>
+#include <string>
+#include <string_view>
+
+namespace util {
+namespace multipart {
+
+struct header {
+  std::string value;
+  std::map<std::string, std::string> params;
+};
+
+struct part {
+  std::string name;
+  std::string filename;
+  /// header names are stored in lower case
+  std::map<std::string, header> headers;
+};
+
+inline std::string to_lower(std::string_view str) {
+  std::string result(str);
+  std::transform(result.begin(), result.end(), result.begin(),
+                 [](unsigned char c) { return std::tolower(c); });
+  return result;
+}
+
+inline std::string_view trim(std::string_view str) {
+  while (!str.empty() && (str.front() == ' ' || str.front() == '\t'))
+    str.remove_prefix(1);
+  while (!str.empty() && (str.back() == ' ' || str.back() == '\t'))
+    str.remove_suffix(1);
+  return str;
+}
+
+inline std::string unquote(std::string_view str) {
+  str = trim(str);
+  if (str.size() >= 2 && str.front() == '"' && str.back() == '"')
+    str = str.substr(1, str.size() - 2);
+  return std::string(str);
+}
+
+/// parses `value; key=v; key2="v2"` as found in Content-Type and
+/// Content-Disposition
+inline header parse_header_value(std::string_view raw) {
+  header result;
+  auto pos = raw.find(';');
+  result.value = std::string(trim(raw.substr(0, pos)));
+  while (pos != std::string_view::npos) {
+    raw.remove_prefix(pos + 1);
+    pos = raw.find(';');
+    auto param = raw.substr(0, pos);
+    auto eq = param.find('=');
+    if (eq == std::string_view::npos)
+      continue;
+    result.params[to_lower(trim(param.substr(0, eq)))] =
+        unquote(param.substr(eq + 1));
+  }
+  return result;
+}
+
+/// extracts the boundary from a `multipart/form-data; boundary=...` header
+inline std::string get_boundary(const std::string &content_type) {
+  auto value = parse_header_value(content_type);
+  auto it = value.params.find("boundary");
+  if (to_lower(value.value).rfind("multipart/", 0) != 0 ||
+      it == value.params.end() || it->second.empty()) {
+    throw std::runtime_error("expected a multipart/form-data body");
+  }
+  return it->second;
+}
+
+/// Incremental multipart/form-data parser.
+///
+/// Bytes are pushed through `feed` in slices of any size and part bodies are
+/// forwarded to `on_data` as soon as they are known not to contain the
+/// delimiter, so only the delimiter tail and the headers of the current part
+/// are ever buffered.
+class parser {
+  enum class state { preamble, delimiter, headers, body, done };
+
+  const std::string delimiter;
+  std::function<void(const part &)> on_begin;
+  std::function<void(std::string_view)> on_data;
+  std::function<void()> on_end;
+
+  state current = state::preamble;
+  std::string buffer;
+  part current_part;
+
+  void parse_headers(std::string_view block) {
+    current_part = part{};
+    while (!block.empty()) {
+      auto eol = block.find("\r\n");
+      auto line = block.substr(0, eol);
+      block.remove_prefix(eol == std::string_view::npos ? block.size()
+                                                         : eol + 2);
+      auto colon = line.find(':');
+      if (colon == std::string_view::npos)
+        throw std::runtime_error("Malformed multipart header");
+      current_part.headers[to_lower(trim(line.substr(0, colon)))] =
+          parse_header_value(line.substr(colon + 1));
+    }
+    auto disposition = current_part.headers.find("content-disposition");
+    if (disposition == current_part.headers.end()) {
+      throw std::runtime_error("No Content-Disposition found");
+    }
+    auto &params = disposition->second.params;
+    if (auto it = params.find("name"); it != params.end())
+      current_part.name = it->second;
+    if (auto it = params.find("filename"); it != params.end())
+      current_part.filename = it->second;
+  }
+
+  /// returns false when more input is needed
+  bool step() {
+    switch (current) {
+    case state::preamble: {
+      // the first delimiter is not required to be preceded by CRLF
+      auto pos = buffer.find(std::string_view(delimiter).substr(2));
+      if (pos == std::string::npos) {
+        auto keep = std::min(buffer.size(), delimiter.size());
+        buffer.erase(0, buffer.size() - keep);
+        return false;
+      }
+      buffer.erase(0, pos + delimiter.size() - 2);
+      current = state::delimiter;
+      return true;
+    }
+    case state::delimiter:
+      if (buffer.size() < 2)
+        return false;
+      if (buffer.compare(0, 2, "--") == 0) {
+        current = state::done;
+        buffer.clear();
+        return false;
+      }
+      if (auto eol = buffer.find("\r\n"); eol != std::string::npos) {
+        // transport padding is allowed after the delimiter
+        buffer.erase(0, eol + 2);
+        current = state::headers;
+        return true;
+      }
+      if (buffer.size() > constants::upload::max_part_headers_size)
+        throw std::runtime_error("Malformed multipart delimiter");
+      return false;
+    case state::headers: {
+      auto end = buffer.find("\r\n\r\n");
+      if (end == std::string::npos) {
+        if (buffer.size() > constants::upload::max_part_headers_size)
+          throw std::runtime_error("Multipart part headers are too large");
+        return false;
+      }
+      parse_headers(std::string_view(buffer).substr(0, end));
+      buffer.erase(0, end + 4);
+      on_begin(current_part);
+      current = state::body;
+      return true;
+    }
+    case state::body: {
+      auto pos = buffer.find(delimiter);
+      if (pos == std::string::npos) {
+        // keep what could be the beginning of a delimiter split by the slice
+        if (buffer.size() >= delimiter.size()) {
+          auto safe = buffer.size() - delimiter.size() + 1;
+          on_data(std::string_view(buffer).substr(0, safe));
+          buffer.erase(0, safe);
+        }
+        return false;
+      }
+      if (pos)
+        on_data(std::string_view(buffer).substr(0, pos));
+      buffer.erase(0, pos + delimiter.size());
+      on_end();
+      current = state::delimiter;
+      return true;
+    }
+    case state::done:
+      return false;
+    }
+    return false;
+  }
+
+public:
+  parser(const std::string &boundary, std::function<void(const part &)> on_begin,
+         std::function<void(std::string_view)> on_data,
+         std::function<void()> on_end)
+      : delimiter("\r\n--" + boundary), on_begin(std::move(on_begin)),
+        on_data(std::move(on_data)), on_end(std::move(on_end)) {
+    buffer.reserve(constants::upload::chunk_size + delimiter.size());
+  }
+
+  void feed(std::string_view chunk) {
+    if (current == state::done)
+      return;
+    buffer.append(chunk);
+    while (step()) {
+    }
+  }
+
+  /// throws if the body ended before the closing delimiter
+  void finish() {
+    if (current != state::done)
+      throw std::runtime_error("Unexpected end of multipart body");
+  }
+
+  bool done() const { return current == state::done; }
+};
+} // namespace multipart
+} // namespace util
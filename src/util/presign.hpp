@@ -0,0 +1,63 @@
+#pragma once
+#include "base64.hpp"
+#include "token.hpp"
+#include <cstdint>
+#include <optional>
+#include <string>
+#include <string_view>
+#include <vector>
+
+namespace util {
+namespace presign {
+/// Signature of a presigned url: `base64url(length:field...expires)` `.`
+/// `base64url(hmac)`. Fields are length prefixed, so they may hold any
+/// byte. The MAC input is prefixed so a url signature can never pass as a
+/// bearer token made with the same secret, and vice versa.
+inline std::string sign(const std::vector<std::string> &fields,
+                        std::int64_t expires, std::string_view secret) {
+  std::string payload;
+  for (const auto &field : fields) {
+    payload += std::to_string(field.size()) + ":" + field;
+  }
+  payload += std::to_string(expires);
+  auto encoded = base64::encode_url(payload);
+  return encoded + "." + token::sign("presign:" + encoded, secret);
+}
+
+/// the signed fields when `signature` is valid and has not expired at `now`
+inline std::optional<std::vector<std::string>>
+verify(std::string_view signature, std::string_view secret,
+       std::int64_t now) {
+  auto dot = signature.find('.');
+  if (dot == std::string_view::npos) {
+    return {};
+  }
+  auto encoded = signature.substr(0, dot);
+  if (!constant_time_equal(
+          token::sign("presign:" + std::string(encoded), secret),
+          signature.substr(dot + 1))) {
+    return {};
+  }
+  auto payload = base64::decode_url(encoded);
+  if (!payload) {
+    return {};
+  }
+  std::vector<std::string> fields;
+  std::string_view rest(*payload);
+  for (auto colon = rest.find(':'); colon != std::string_view::npos;
+       colon = rest.find(':')) {
+    auto length = token::parse_number<std::size_t>(rest.substr(0, colon));
+    if (!length || *length > rest.size() - colon - 1) {
+      return {};
+    }
+    fields.emplace_back(rest.substr(colon + 1, *length));
+    rest.remove_prefix(colon + 1 + *length);
+  }
+  auto expires = token::parse_number<std::int64_t>(rest);
+  if (!expires || *expires <= now) {
+    return {};
+  }
+  return fields;
+}
+} // namespace presign
+} // namespace util
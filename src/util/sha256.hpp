@@ -0,0 +1,204 @@
+#pragma once
+#include "cpu.hpp"
+#include <algorithm>
+#include <array>
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
+#include <string>
+#include <string_view>
+
+namespace util {
+/// Incremental SHA-256 (FIPS 180-4), fed with `update` as bytes arrive.
+/// Blocks are compressed with the x86 SHA extensions when the cpu has them.
+class sha256 {
+public:
+  using digest_type = std::array<std::uint8_t, 32>;
+
+private:
+  using kernel = void (*)(std::uint32_t *, const std::uint8_t *, std::size_t);
+
+  static constexpr std::uint32_t k[64] = {
+      0x428a2f98, 0x71374491, 0xb5c0fbcf, 0xe9b5dba5, 0x3956c25b, 0x59f111f1,
+      0x923f82a4, 0xab1c5ed5, 0xd807aa98, 0x12835b01, 0x243185be, 0x550c7dc3,
+      0x72be5d74, 0x80deb1fe, 0x9bdc06a7, 0xc19bf174, 0xe49b69c1, 0xefbe4786,
+      0x0fc19dc6, 0x240ca1cc, 0x2de92c6f, 0x4a7484aa, 0x5cb0a9dc, 0x76f988da,
+      0x983e5152, 0xa831c66d, 0xb00327c8, 0xbf597fc7, 0xc6e00bf3, 0xd5a79147,
+      0x06ca6351, 0x14292967, 0x27b70a85, 0x2e1b2138, 0x4d2c6dfc, 0x53380d13,
+      0x650a7354, 0x766a0abb, 0x81c2c92e, 0x92722c85, 0xa2bfe8a1, 0xa81a664b,
+      0xc24b8b70, 0xc76c51a3, 0xd192e819, 0xd6990624, 0xf40e3585, 0x106aa070,
+      0x19a4c116, 0x1e376c08, 0x2748774c, 0x34b0bcb5, 0x391c0cb3, 0x4ed8aa4a,
+      0x5b9cca4f, 0x682e6ff3, 0x748f82ee, 0x78a5636f, 0x84c87814, 0x8cc70208,
+      0x90befffa, 0xa4506ceb, 0xbef9a3f7, 0xc67178f2};
+
+  std::uint32_t state[8] = {0x6a09e667, 0xbb67ae85, 0x3c6ef372, 0xa54ff53a,
+                            0x510e527f, 0x9b05688c, 0x1f83d9ab, 0x5be0cd19};
+  std::uint8_t block[64];
+  std::size_t block_size = 0;
+  std::uint64_t length = 0;
+
+  static constexpr std::uint32_t rotr(std::uint32_t x, int n) {
+    return (x >> n) | (x << (32 - n));
+  }
+
+  /// compresses `count` consecutive 64 byte blocks
+  static void compress_generic(std::uint32_t *state, const std::uint8_t *data,
+                               std::size_t count) {
+    for (; count; count--, data += 64) {
+      std::uint32_t w[64];
+      for (int i = 0; i < 16; i++) {
+        w[i] = std::uint32_t(data[i * 4]) << 24 |
+               std::uint32_t(data[i * 4 + 1]) << 16 |
+               std::uint32_t(data[i * 4 + 2]) << 8 |
+               std::uint32_t(data[i * 4 + 3]);
+      }
+      for (int i = 16; i < 64; i++) {
+        auto s0 = rotr(w[i - 15], 7) ^ rotr(w[i - 15], 18) ^ (w[i - 15] >> 3);
+        auto s1 = rotr(w[i - 2], 17) ^ rotr(w[i - 2], 19) ^ (w[i - 2] >> 10);
+        w[i] = w[i - 16] + s0 + w[i - 7] + s1;
+      }
+      auto a = state[0], b = state[1], c = state[2], d = state[3],
+           e = state[4], f = state[5], g = state[6], h = state[7];
+      for (int i = 0; i < 64; i++) {
+        auto t1 = h + (rotr(e, 6) ^ rotr(e, 11) ^ rotr(e, 25)) +
+                  ((e & f) ^ (~e & g)) + k[i] + w[i];
+        auto t2 = (rotr(a, 2) ^ rotr(a, 13) ^ rotr(a, 22)) +
+                  ((a & b) ^ (a & c) ^ (b & c));
+        h = g;
+        g = f;
+        f = e;
+        e = d + t1;
+        d = c;
+        c = b;
+        b = a;
+        a = t1 + t2;
+      }
+      state[0] += a;
+      state[1] += b;
+      state[2] += c;
+      state[3] += d;
+      state[4] += e;
+      state[5] += f;
+      state[6] += g;
+      state[7] += h;
+    }
+  }
+
+#if defined(XBUCKET_X86)
+  XBUCKET_TARGET("sha,sse4.1")
+  static void compress_sha(std::uint32_t *state, const std::uint8_t *data,
+                           std::size_t count) {
+    const __m128i byte_swap =
+        _mm_set_epi64x(0x0c0d0e0f08090a0bULL, 0x0405060700010203ULL);
+    // the instructions work on the state split as ABEF / CDGH
+    auto tmp = _mm_shuffle_epi32(
+        _mm_loadu_si128(reinterpret_cast<const __m128i *>(&state[0])), 0xb1);
+    auto state1 = _mm_shuffle_epi32(
+        _mm_loadu_si128(reinterpret_cast<const __m128i *>(&state[4])), 0x1b);
+    auto state0 = _mm_alignr_epi8(tmp, state1, 8);
+    state1 = _mm_blend_epi16(state1, tmp, 0xf0);
+
+    for (; count; count--, data += 64) {
+      auto abef = state0, cdgh = state1;
+      __m128i w[16];
+      for (int i = 0; i < 16; i++) {
+        if (i < 4) {
+          w[i] = _mm_shuffle_epi8(
+              _mm_loadu_si128(reinterpret_cast<const __m128i *>(data + i * 16)),
+              byte_swap);
+        } else {
+          w[i] = _mm_sha256msg2_epu32(
+              _mm_add_epi32(_mm_sha256msg1_epu32(w[i - 4], w[i - 3]),
+                            _mm_alignr_epi8(w[i - 1], w[i - 2], 4)),
+              w[i - 1]);
+        }
+        auto msg = _mm_add_epi32(
+            w[i], _mm_loadu_si128(reinterpret_cast<const __m128i *>(&k[i * 4])));
+        state1 = _mm_sha256rnds2_epu32(state1, state0, msg);
+        state0 =
+            _mm_sha256rnds2_epu32(state0, state1, _mm_shuffle_epi32(msg, 0x0e));
+      }
+      state0 = _mm_add_epi32(state0, abef);
+      state1 = _mm_add_epi32(state1, cdgh);
+    }
+
+    tmp = _mm_shuffle_epi32(state0, 0x1b);
+    state1 = _mm_shuffle_epi32(state1, 0xb1);
+    _mm_storeu_si128(reinterpret_cast<__m128i *>(&state[0]),
+                     _mm_blend_epi16(tmp, state1, 0xf0));
+    _mm_storeu_si128(reinterpret_cast<__m128i *>(&state[4]),
+                     _mm_alignr_epi8(state1, tmp, 8));
+  }
+#endif
+
+  static void compress(std::uint32_t *state, const std::uint8_t *data,
+                       std::size_t count) {
+    static const kernel impl = [] {
+#if defined(XBUCKET_X86)
+      if (cpu::get().sha)
+        return (kernel)compress_sha;
+#endif
+      return (kernel)compress_generic;
+    }();
+    if (count)
+      impl(state, data, count);
+  }
+
+public:
+  sha256 &update(std::string_view data) {
+    auto bytes = reinterpret_cast<const std::uint8_t *>(data.data());
+    auto size = data.size();
+    length += size;
+    if (block_size) {
+      auto take = std::min(size, sizeof(block) - block_size);
+      std::memcpy(block + block_size, bytes, take);
+      block_size += take;
+      bytes += take;
+      size -= take;
+      if (block_size < sizeof(block))
+        return *this;
+      compress(state, block, 1);
+      block_size = 0;
+    }
+    compress(state, bytes, size / 64);
+    bytes += size / 64 * 64;
+    size %= 64;
+    std::memcpy(block, bytes, size);
+    block_size = size;
+    return *this;
+  }
+
+  digest_type digest() {
+    auto bits = length * 8;
+    std::uint8_t padding[72] = {0x80};
+    auto padding_size = (block_size < 56 ? 56 : 120) - block_size;
+    for (int i = 0; i < 8; i++) {
+      padding[padding_size + i] = std::uint8_t(bits >> (56 - i * 8));
+    }
+    update({reinterpret_cast<const char *>(padding), padding_size + 8});
+    digest_type result;
+    for (int i = 0; i < 8; i++) {
+      result[i * 4] = std::uint8_t(state[i] >> 24);
+      result[i * 4 + 1] = std::uint8_t(state[i] >> 16);
+      result[i * 4 + 2] = std::uint8_t(state[i] >> 8);
+      result[i * 4 + 3] = std::uint8_t(state[i]);
+    }
+    return result;
+  }
+
+  std::string hex_digest() {
+    constexpr auto digits = "0123456789abcdef";
+    std::string result;
+    result.reserve(64);
+    for (auto byte : digest()) {
+      result += digits[byte >> 4];
+      result += digits[byte & 0xf];
+    }
+    return result;
+  }
+
+  static std::string hex_digest(std::string_view data) {
+    return sha256{}.update(data).hex_digest();
+  }
+};
+} // namespace util
@@ -0,0 +1,92 @@
+#pragma once
+#include "base64.hpp"
+#include "hmac.hpp"
+#include <algorithm>
+#include <charconv>
+#include <cstdint>
+#include <optional>
+#include <string>
+#include <string_view>
+#include <vector>
+
+namespace util {
+namespace token {
+/// what a bearer token grants, the signature covers every field
+struct claims {
+  int user_id;
+  std::int64_t expires;
+  std::vector<std::string> scopes;
+
+  bool has_scope(std::string_view scope) const {
+    return std::find(scopes.begin(), scopes.end(), scope) != scopes.end();
+  }
+};
+
+inline std::string sign(std::string_view payload, std::string_view secret) {
+  auto mac = hmac_sha256(secret, payload);
+  return base64::encode_url(std::string_view(
+      reinterpret_cast<const char *>(mac.data()), mac.size()));
+}
+
+/// `base64url(user_id:expires:scope,...)` `.` `base64url(hmac)`
+inline std::string issue(const claims &claims, std::string_view secret) {
+  auto payload =
+      std::to_string(claims.user_id) + ":" + std::to_string(claims.expires) + ":";
+  for (std::size_t i = 0; i < claims.scopes.size(); i++) {
+    payload += (i ? "," : "") + claims.scopes[i];
+  }
+  auto encoded = base64::encode_url(payload);
+  return encoded + "." + sign(encoded, secret);
+}
+
+template <typename T> std::optional<T> parse_number(std::string_view str) {
+  T value;
+  auto [end, error] = std::from_chars(str.data(), str.data() + str.size(), value);
+  if (error != std::errc{} || end != str.data() + str.size()) {
+    return {};
+  }
+  return value;
+}
+
+/// the token's claims when its signature is valid and it has not expired
+/// at `now`
+inline std::optional<claims> verify(std::string_view token,
+                                    std::string_view secret,
+                                    std::int64_t now) {
+  auto dot = token.find('.');
+  if (dot == std::string_view::npos) {
+    return {};
+  }
+  auto encoded = token.substr(0, dot);
+  if (!constant_time_equal(sign(encoded, secret), token.substr(dot + 1))) {
+    return {};
+  }
+  auto payload = base64::decode_url(encoded);
+  if (!payload) {
+    return {};
+  }
+  std::string_view fields(*payload);
+  auto first = fields.find(':');
+  auto second = fields.find(':', first == std::string_view::npos ? first
+                                                                 : first + 1);
+  if (second == std::string_view::npos) {
+    return {};
+  }
+  auto user_id = parse_number<int>(fields.substr(0, first));
+  auto expires =
+      parse_number<std::int64_t>(fields.substr(first + 1, second - first - 1));
+  if (!user_id || !expires || *expires <= now) {
+    return {};
+  }
+  claims result{*user_id, *expires, {}};
+  auto scopes = fields.substr(second + 1);
+  while (!scopes.empty()) {
+    auto comma = scopes.find(',');
+    result.scopes.emplace_back(scopes.substr(0, comma));
+    scopes.remove_prefix(comma == std::string_view::npos ? scopes.size()
+                                                         : comma + 1);
+  }
+  return result;
+}
+} // namespace token
+} // namespace util
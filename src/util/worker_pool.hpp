@@ -0,0 +1,82 @@
+#pragma once
+#include <algorithm>
+#include <condition_variable>
+#include <cstddef>
+#include <deque>
+#include <functional>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+namespace util {
+/// Fixed set of threads draining a bounded queue. `try_submit` refuses work
+/// once `capacity` tasks are waiting, so callers can push back instead of
+/// piling up work (and memory) they can't get through.
+class worker_pool {
+  std::mutex mutex;
+  std::condition_variable ready;
+  std::deque<std::function<void()>> tasks;
+  std::vector<std::thread> threads;
+  const std::size_t capacity;
+  bool stopped = false;
+
+  void run() {
+    for (;;) {
+      std::function<void()> task;
+      {
+        std::unique_lock lock(mutex);
+        ready.wait(lock, [this] { return stopped || !tasks.empty(); });
+        if (tasks.empty()) {
+          return;
+        }
+        task = std::move(tasks.front());
+        tasks.pop_front();
+      }
+      task();
+    }
+  }
+
+public:
+  /// `size` 0 uses half the cores
+  worker_pool(std::size_t size, std::size_t capacity) : capacity(capacity) {
+    if (size == 0) {
+      size = std::max(1u, std::thread::hardware_concurrency() / 2);
+    }
+    for (std::size_t i = 0; i < size; i++) {
+      threads.emplace_back([this] { run(); });
+    }
+  }
+
+  worker_pool(const worker_pool &) = delete;
+  worker_pool &operator=(const worker_pool &) = delete;
+
+  /// finishes the queued tasks before returning
+  ~worker_pool() {
+    {
+      std::lock_guard lock(mutex);
+      stopped = true;
+    }
+    ready.notify_all();
+    for (auto &thread : threads) {
+      thread.join();
+    }
+  }
+
+  bool try_submit(std::function<void()> task) {
+    {
+      std::lock_guard lock(mutex);
+      if (stopped || tasks.size() >= capacity) {
+        return false;
+      }
+      tasks.push_back(std::move(task));
+    }
+    ready.notify_one();
+    return true;
+  }
+
+  std::size_t pending() {
+    std::lock_guard lock(mutex);
+    return tasks.size();
+  }
+};
+} // namespace util
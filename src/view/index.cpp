@@ -2,7 +2,6 @@
 #include "../lib/hyper.hpp"
 #include "crow/common.h"
 #include "view.hpp"
-#include <regex>
 #include <string>
 namespace view {
 using namespace hyper;
@@ -13,12 +12,52 @@ std::string row_example(const std::string &label, const std::string &sample) {
       {{"label", label}, {"sample", sample}}};
 }
 
-std::string beautify_json_sample(std::string json) {
-  json = std::regex_replace(json, std::regex("\","), "\",\n");
-  json = std::regex_replace(json, std::regex("\\{"), "{\n");
-  json = std::regex_replace(json, std::regex("\\}"), "\n}");
-  json = std::regex_replace(json, std::regex("\n\""), "\n\t\"");
-  return json;
+/// indents a compact json dump, one member per line
+std::string beautify_json_sample(const std::string &json) {
+  std::string result;
+  result.reserve(json.size() * 2);
+  int depth = 0;
+  bool quoted = false, escaped = false;
+  auto newline = [&result, &depth] {
+    result += '\n';
+    result.append(depth, '\t');
+  };
+  for (char c : json) {
+    if (quoted) {
+      result += c;
+      quoted = escaped || c != '"';
+      escaped = !escaped && c == '\\';
+      continue;
+    }
+    switch (c) {
+    case '"':
+      quoted = true;
+      result += c;
+      break;
+    case '{':
+    case '[':
+      result += c;
+      depth++;
+      newline();
+      break;
+    case '}':
+    case ']':
+      depth--;
+      newline();
+      result += c;
+      break;
+    case ',':
+      result += c;
+      newline();
+      break;
+    case ':':
+      result += ": ";
+      break;
+    default:
+      result += c;
+    }
+  }
+  return result;
 }
 
 std::string route_row(const controller::route_descr &desc) {
@@ -63,21 +102,16 @@ routes_table(const std::pair<std::string, std::list<controller::route_descr>>
 }
 
 std::string routes() {
-  static std::string routes_table_content = "";
-  static bool routes_table_content_rendered = false;
-
-  if (not routes_table_content_rendered) {
-    for (auto &r : controller::controller::routes) {
-      routes_table_content += routes_table(r);
-    }
-    routes_table_content_rendered = true;
+  std::string content;
+  for (auto &r : controller::controller::routes) {
+    content += routes_table(r);
   }
-
-  return routes_table_content;
+  return content;
 }
 
+/// rendered once, after every controller registered its routes
 std::string index() {
-  static auto docs = routes();
+  auto docs = routes();
   return html<
       head<meta<charset, "UTF-8">,
            meta<viewport, "width=device-width, initial-scale=1.0">,
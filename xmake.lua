@@ -1,11 +1,49 @@
 add_rules("mode.debug", "mode.release", "plugin.compile_commands.autoupdate")
-add_requires("crow", "opencv", "sqlite_orm", "sqlite3")
+add_requires("crow", "opencv", "sqlite_orm", "sqlite3", "zlib", "zstd")
+add_requires("brotli", {optional = true})
+
+-- `xmake f --bench=y` adds the xbucket-bench target and its dependency
+option("bench")
+set_default(false)
+set_showmenu(true)
+set_description("Build the xbucket-bench benchmarks")
+option_end()
+
+if has_config("bench") then
+    add_requires("benchmark")
+end
+
+-- codings beyond gzip are compiled in only when their package resolved,
+-- shared by every target that links the compression middleware
+rule("xbucket.codecs")
+on_load(function (target)
+    if has_package("zstd") then
+        target:add("defines", "XBUCKET_ZSTD")
+    end
+    if has_package("brotli") then
+        target:add("defines", "XBUCKET_BROTLI")
+    end
+end)
+rule_end()
 
 target("xbucket")
 set_languages("c++23")
 set_kind("binary")
 add_files("src/*.cpp", "src/view/*.cpp", "src/controller/*.cpp")
-add_packages("crow", "opencv", "sqlite_orm", "sqlite3")
+add_packages("crow", "opencv", "sqlite_orm", "sqlite3", "zlib", "zstd", "brotli")
+add_rules("xbucket.codecs")
+
+if has_config("bench") then
+-- micro-benchmarks, or `xmake run xbucket-bench --load` against a running server
+target("xbucket-bench")
+set_languages("c++23")
+set_kind("binary")
+set_default(false)
+add_files("bench/*.cpp")
+add_includedirs("src")
+add_packages("crow", "opencv", "sqlite_orm", "sqlite3", "zlib", "zstd", "brotli", "benchmark")
+add_rules("xbucket.codecs")
+end
 
 --
 -- If you want to known more usage about xmake, please see https://xmake.io